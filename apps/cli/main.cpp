@@ -1,6 +1,8 @@
 #include "triplefill/animation.hpp"
 #include "triplefill/fill.hpp"
+#include "triplefill/frame_sink.hpp"
 #include "triplefill/image.hpp"
+#include "triplefill/paged_fill.hpp"
 #include "triplefill/pixel.hpp"
 #include "triplefill/point.hpp"
 
@@ -21,6 +23,11 @@ struct Args {
     double tolerance          = 0.1;
     int    frame_freq         = 1000;
     triplefill::Algorithm algo = triplefill::Algorithm::BFS;
+    unsigned threads          = 0;
+    triplefill::Layout layout = triplefill::Layout::RowMajor;
+    triplefill::Connectivity connectivity = triplefill::Connectivity::Four;
+    triplefill::ColorMetric  metric       = triplefill::ColorMetric::Hsl;
+    triplefill::Point size{0, 0}; // raw .rgba input only
     std::string picker_name   = "solid";
 
     triplefill::RGBA color{255, 0, 0, 255};
@@ -35,12 +42,21 @@ struct Args {
 void print_usage(const char* prog) {
     std::cerr
         << "Usage: " << prog << " [OPTIONS]\n\n"
-        << "  --input <path.png>         Input PNG image\n"
-        << "  --output <path.png|gif>    Output file (.png or .gif)\n"
+        << "  --input <path.png|rgba>    Input PNG, or raw RGBA filled tile by tile\n"
+        << "  --output <path.png|gif|rgba|->\n"
+        << "                             Output file (.rgba for raw input); - streams\n"
+        << "                             every frame to stdout as raw RGBA\n"
+        << "  --size <WxH>               Dimensions of a raw .rgba input\n"
         << "  --seed <x,y>              Seed pixel coordinates\n"
         << "  --tolerance <double>       Colour tolerance (default 0.1)\n"
         << "  --frame-freq <int>         Frame capture frequency (default 1000)\n"
-        << "  --algo <bfs|dfs>           Fill algorithm (default bfs)\n"
+        << "  --algo <bfs|dfs|scanline|parallel>\n"
+        << "                             Fill algorithm (default bfs)\n"
+        << "  --threads <int>            Worker threads for parallel (default: all)\n"
+        << "  --layout <row|tiled>       In-memory pixel layout (default row)\n"
+        << "  --connectivity <4|8>       Include diagonal neighbours with 8 (default 4)\n"
+        << "  --metric <hsl|rgb|max|premultiplied|lab>\n"
+        << "                             Colour distance for --tolerance (default hsl)\n"
         << "  --picker <solid|stripe|quarter|border>\n"
         << "\n  Picker parameters:\n"
         << "    solid:   --color <r,g,b,a>\n"
@@ -83,12 +99,30 @@ bool parse_args(int argc, char* argv[], Args& args) {
         else if (arg == "--input")    args.input         = next();
         else if (arg == "--output")   args.output        = next();
         else if (arg == "--seed")     args.seed          = parse_point(next());
+        else if (arg == "--size")     args.size          = parse_point(next());
         else if (arg == "--tolerance") args.tolerance     = std::stod(next());
         else if (arg == "--frame-freq") args.frame_freq   = std::stoi(next());
         else if (arg == "--algo") {
             auto v = next();
-            args.algo = (v == "dfs") ? triplefill::Algorithm::DFS
-                                     : triplefill::Algorithm::BFS;
+            args.algo = (v == "dfs")      ? triplefill::Algorithm::DFS
+                      : (v == "scanline") ? triplefill::Algorithm::Scanline
+                      : (v == "parallel") ? triplefill::Algorithm::Parallel
+                                          : triplefill::Algorithm::BFS;
+        }
+        else if (arg == "--threads")      args.threads      = static_cast<unsigned>(std::stoi(next()));
+        else if (arg == "--layout")
+            args.layout = next() == "tiled" ? triplefill::Layout::Tiled
+                                            : triplefill::Layout::RowMajor;
+        else if (arg == "--connectivity")
+            args.connectivity = next() == "8" ? triplefill::Connectivity::Eight
+                                              : triplefill::Connectivity::Four;
+        else if (arg == "--metric") {
+            auto v = next();
+            args.metric = (v == "rgb")           ? triplefill::ColorMetric::Rgb
+                        : (v == "max")           ? triplefill::ColorMetric::MaxChannel
+                        : (v == "premultiplied") ? triplefill::ColorMetric::PremultipliedRgb
+                        : (v == "lab")           ? triplefill::ColorMetric::Lab
+                                                 : triplefill::ColorMetric::Hsl;
         }
         else if (arg == "--picker")       args.picker_name  = next();
         else if (arg == "--color")        args.color        = parse_rgba(next());
@@ -107,6 +141,28 @@ bool parse_args(int argc, char* argv[], Args& args) {
     return true;
 }
 
+/// Only reached when the library was built with TRIPLEFILL_STATS.
+void print_telemetry(const triplefill::FillStats& s) {
+    const auto& t = s.telemetry;
+    std::cerr << "Telemetry:\n"
+              << "  tolerance evaluations " << t.tolerance_evaluations << "\n"
+              << "  colour memo hits      " << t.memo_hits;
+    if (t.tolerance_evaluations)
+        std::cerr << " (" << 100.0 * static_cast<double>(t.memo_hits) /
+                                 static_cast<double>(t.tolerance_evaluations)
+                  << "%)";
+    std::cerr << "\n"
+              << "  neighbour tests       " << t.neighbour_tests
+              << " (" << t.rejected_neighbours << " rejected)\n"
+              << "  picker calls          " << t.picker_calls << "\n"
+              << "  frontier peak         " << s.frontier_peak << "\n"
+              << "  frame copy bytes      " << t.frame_copy_bytes << "\n"
+              << "  setup / traverse / paint / capture (ms) "
+              << t.setup_seconds * 1e3 << " / " << t.traverse_seconds * 1e3
+              << " / " << t.paint_seconds * 1e3 << " / "
+              << t.capture_seconds * 1e3 << "\n";
+}
+
 } // namespace
 
 int main(int argc, char* argv[]) {
@@ -121,10 +177,6 @@ int main(int argc, char* argv[]) {
     }
 
     try {
-        auto img = triplefill::load_png(args.input);
-        std::cerr << "Loaded " << img.width() << "x" << img.height()
-                  << " image from " << args.input << "\n";
-
         triplefill::PickerConfig picker;
         if (args.picker_name == "solid") {
             picker = triplefill::SolidPicker{args.color};
@@ -142,31 +194,79 @@ int main(int argc, char* argv[]) {
         }
 
         triplefill::FillConfig cfg{
-            .seed       = args.seed,
-            .tolerance  = args.tolerance,
-            .frame_freq = args.frame_freq,
-            .algorithm  = args.algo,
-            .picker     = picker,
+            .seed         = args.seed,
+            .tolerance    = args.tolerance,
+            .frame_freq   = args.frame_freq,
+            .algorithm    = args.algo,
+            .picker       = picker,
+            .threads      = args.threads,
+            .connectivity = args.connectivity,
+            .metric       = args.metric,
         };
 
-        std::cerr << "Running flood fill ("
-                  << (args.algo == triplefill::Algorithm::BFS ? "BFS" : "DFS")
-                  << ") from (" << args.seed.x << "," << args.seed.y << ")...\n";
-
-        auto anim = triplefill::flood_fill(img, cfg);
-
-        std::cerr << "Fill complete: " << anim.size() << " frames captured.\n";
+        const char* algo_name =
+            args.algo == triplefill::Algorithm::DFS      ? "DFS"
+          : args.algo == triplefill::Algorithm::Scanline ? "Scanline"
+          : args.algo == triplefill::Algorithm::Parallel ? "Parallel"
+                                                         : "BFS";
 
         // Create output directory if needed
         auto parent = std::filesystem::path(args.output).parent_path();
         if (!parent.empty())
             std::filesystem::create_directories(parent);
 
+        if (std::filesystem::path(args.input).extension() == ".rgba") {
+            if (args.size.x <= 0 || args.size.y <= 0) {
+                std::cerr << "Error: raw input needs --size <WxH>.\n";
+                return 1;
+            }
+            std::cerr << "Running flood fill (" << algo_name << ") on "
+                      << args.size.x << "x" << args.size.y
+                      << " raw image, tile by tile...\n";
+            const auto stats = triplefill::flood_fill_file(
+                args.input, args.output, static_cast<unsigned>(args.size.x),
+                static_cast<unsigned>(args.size.y), cfg);
+            std::cerr << "Filled " << stats.filled_pixels
+                      << " pixels; wrote " << args.output << "\n";
+            if constexpr (triplefill::telemetry_enabled)
+                print_telemetry(stats);
+            return 0;
+        }
+
+        auto img = triplefill::load_png(args.input);
+        std::cerr << "Loaded " << img.width() << "x" << img.height()
+                  << " image from " << args.input << "\n";
+        if (args.layout != img.layout())
+            img = img.converted(args.layout);
+
+        std::cerr << "Running flood fill (" << algo_name
+                  << ") from (" << args.seed.x << "," << args.seed.y << ")...\n";
+
+        // GIF and raw frames are written as the fill produces them, not
+        // stored.
         auto ext = std::filesystem::path(args.output).extension().string();
-        if (ext == ".gif") {
-            anim.write_gif(args.output);
-            std::cerr << "Wrote animated GIF to " << args.output << "\n";
+        if (ext == ".gif" || args.output == "-") {
+            triplefill::FillStats stats;
+            if (ext == ".gif") {
+                triplefill::GifSink gif(args.output);
+                stats = triplefill::flood_fill(img, cfg, gif);
+                gif.close();
+            } else {
+                triplefill::RawSink raw(std::cout);
+                stats = triplefill::flood_fill(img, cfg, raw);
+                std::cout.flush();
+            }
+            std::cerr << "Fill complete: " << stats.frames_captured
+                      << " frames written to "
+                      << (ext == ".gif" ? args.output : "stdout") << ".\n";
+            if constexpr (triplefill::telemetry_enabled)
+                print_telemetry(stats);
         } else {
+            auto anim = triplefill::flood_fill(img, cfg);
+            std::cerr << "Fill complete: " << anim.size()
+                      << " frames captured.\n";
+            if constexpr (triplefill::telemetry_enabled)
+                print_telemetry(anim.stats());
             anim.write_last_png(args.output);
             std::cerr << "Wrote final PNG to " << args.output << "\n";
         }
@@ -9,8 +9,19 @@
 //   frameFreq == 0 → final-only (1 frame, no intermediates)
 //   maxFrames == 0 → unlimited intermediate frames (nullopt)
 //   maxFrames > 0  → cap intermediate frames to that number; final always appended
+//
+// Limits (trailing arguments; omitted or <= 0 means none):
+//   timeoutMs  → wall-clock deadline measured from the call
+//   maxPixels  → stop after this many filled pixels
+//   maxAnimationBytes → keep the captured frames within this many bytes
+//                       (fill_create only; see max_animation_bytes)
+// fill_estimate_memory reports what a fill of that size may allocate, so
+// the worker can size the budget before copying the image in.
+// fill_get_stop_reason / fill_session_stop_reason report
+//   0 complete, 1 cancelled, 2 deadline, 3 pixel budget.
 
 #include "triplefill/fill.hpp"
+#include "triplefill/fill_session.hpp"
 #include "triplefill/image.hpp"
 #include "triplefill/pixel.hpp"
 #include "triplefill/point.hpp"
@@ -20,6 +31,7 @@
 #include <cstring>
 #include <cstdio>
 #include <algorithm>
+#include <chrono>
 #include <stdexcept>
 
 using namespace triplefill;
@@ -90,12 +102,16 @@ PickerConfig decode_picker(int picker, const double* pp, int pp_len) {
 
 FillConfig build_config(int seed_x, int seed_y, double tolerance,
                         int frame_freq, int algo, int picker,
-                        const double* pp, int pp_len, int max_frames) {
+                        const double* pp, int pp_len, int max_frames,
+                        double timeout_ms = 0, double max_pixels = 0,
+                        double max_animation_bytes = 0) {
     FillConfig cfg;
     cfg.seed       = Point{seed_x, seed_y};
     cfg.tolerance  = std::clamp(tolerance, 0.0, 2.0);
     cfg.frame_freq = std::max(0, frame_freq);
-    cfg.algorithm  = (algo == 1) ? Algorithm::DFS : Algorithm::BFS;
+    cfg.algorithm  = (algo == 1) ? Algorithm::DFS
+                   : (algo == 2) ? Algorithm::Scanline
+                                 : Algorithm::BFS;
     cfg.picker     = decode_picker(picker, pp, pp_len);
 
     // maxFrames == 0 → unlimited (nullopt); >0 → cap
@@ -103,9 +119,37 @@ FillConfig build_config(int seed_x, int seed_y, double tolerance,
         cfg.max_frames = static_cast<std::size_t>(max_frames);
     // else: leave as nullopt (unlimited)
 
+    if (timeout_ms > 0)
+        cfg.deadline = std::chrono::steady_clock::now() +
+                       std::chrono::microseconds(
+                           static_cast<long long>(timeout_ms * 1000.0));
+    if (max_pixels >= 1)
+        cfg.max_pixels = static_cast<std::size_t>(max_pixels);
+    if (max_animation_bytes >= 1)
+        cfg.max_animation_bytes =
+            static_cast<std::size_t>(max_animation_bytes);
+
     return cfg;
 }
 
+/// Owns the source pixels a FillSession reads from, and its cancel token.
+struct SessionHandle {
+    SessionHandle(Image src, FillConfig cfg)
+        : img(std::move(src)), cancel(CancelToken::make()),
+          session(img, with_cancel(std::move(cfg), cancel)) {}
+
+    Image       img;
+    CancelToken cancel;
+    FillSession session;
+    DirtyRect   last_dirty;
+
+private:
+    static FillConfig with_cancel(FillConfig cfg, const CancelToken& token) {
+        cfg.cancel = token;
+        return cfg;
+    }
+};
+
 } // namespace
 
 extern "C" {
@@ -127,6 +171,11 @@ int fill_get_filled_pixels(void* handle) {
     return static_cast<int>(static_cast<Animation*>(handle)->stats().filled_pixels);
 }
 
+int fill_get_stop_reason(void* handle) {
+    if (!handle) return 0;
+    return static_cast<int>(static_cast<Animation*>(handle)->stats().stop);
+}
+
 // ---- Legacy single-shot fill (returns final frame only) -------------------
 // Return codes: 0=ok, -1=invalid args, -2=empty, -3=OOM, -4=too large, -5=other
 
@@ -193,7 +242,8 @@ void* fill_create(
     double tolerance, int frame_freq,
     int algo, int picker,
     const double* picker_params, int picker_params_len,
-    int max_frames)
+    int max_frames, double timeout_ms, double max_pixels,
+    double max_animation_bytes)
 {
     clear_error();
 
@@ -213,7 +263,9 @@ void* fill_create(
 
         FillConfig cfg = build_config(seed_x, seed_y, tolerance, frame_freq,
                                       algo, picker, picker_params,
-                                      picker_params_len, max_frames);
+                                      picker_params_len, max_frames,
+                                      timeout_ms, max_pixels,
+                                      max_animation_bytes);
 
         auto* anim = new Animation(flood_fill(img, cfg));
         if (anim->empty()) {
@@ -231,11 +283,37 @@ void* fill_create(
     }
 }
 
+// Upper estimate in bytes of what fill_create (or, with frame_freq 0, a
+// final-only fill) allocates for a width x height image; -1 on bad input.
+double fill_estimate_memory(int width, int height, int frame_freq, int algo,
+                            int max_frames, double max_animation_bytes)
+{
+    clear_error();
+
+    if (width <= 0 || height <= 0) {
+        set_error(1, "Invalid arguments (non-positive dimensions)");
+        return -1;
+    }
+
+    try {
+        FillConfig cfg = build_config(0, 0, 0, frame_freq, algo, 0, nullptr, 0,
+                                      max_frames, 0, 0, max_animation_bytes);
+        return static_cast<double>(estimate_fill_memory(
+            static_cast<unsigned>(width), static_cast<unsigned>(height), cfg));
+    } catch (...) {
+        set_error(3, "Unexpected internal error");
+        return -1;
+    }
+}
+
 int fill_frame_count(void* handle) {
     if (!handle) return 0;
     return static_cast<int>(static_cast<Animation*>(handle)->size());
 }
 
+// Frames other than the last are rebuilt on demand from stored deltas; the
+// pointer stays valid until the next fill_get_frame call on the handle.
+// Stepping forward through the frames costs only each frame's changes.
 const uint8_t* fill_get_frame(void* handle, int index) {
     if (!handle) return nullptr;
     auto* anim = static_cast<Animation*>(handle);
@@ -248,6 +326,110 @@ void fill_destroy(void* handle) {
     delete static_cast<Animation*>(handle);
 }
 
+// ---- Progressive fill ------------------------------------------------------
+// A FillSession stepped from the worker, so the page can draw the region as
+// it grows. Final frame only (frame_freq is forced to 0). Because the worker
+// yields between steps, fill_session_cancel can stop a stale fill.
+
+void* fill_session_create(
+    const uint8_t* rgba_in, int width, int height,
+    int seed_x, int seed_y,
+    double tolerance, int algo, int picker,
+    const double* picker_params, int picker_params_len,
+    double timeout_ms, double max_pixels)
+{
+    clear_error();
+
+    if (!rgba_in || width <= 0 || height <= 0) {
+        set_error(1, "Invalid arguments (null input or non-positive dimensions)");
+        return nullptr;
+    }
+    if (width > MAX_DIMENSION || height > MAX_DIMENSION) {
+        set_error(1, "Image too large (max 4096x4096)");
+        return nullptr;
+    }
+
+    try {
+        Image img(static_cast<unsigned>(width), static_cast<unsigned>(height));
+        std::memcpy(img.data(), rgba_in,
+                    static_cast<size_t>(width) * height * 4);
+
+        FillConfig cfg = build_config(seed_x, seed_y, tolerance, 0, algo,
+                                      picker, picker_params,
+                                      picker_params_len, 0, timeout_ms,
+                                      max_pixels);
+
+        auto* h = new SessionHandle(std::move(img), cfg);
+        if (h->session.done()) {
+            delete h;
+            set_error(1, "Fill produced no result (seed out of bounds?)");
+            return nullptr;
+        }
+        return h;
+    } catch (const std::bad_alloc&) {
+        set_error(2, "Out of memory");
+        return nullptr;
+    } catch (...) {
+        set_error(3, "Unexpected internal error");
+        return nullptr;
+    }
+}
+
+// Returns 1 when the fill is complete, 0 when more steps remain, -1 on error.
+int fill_session_step(void* handle, int max_pixels) {
+    if (!handle) return -1;
+    auto* h = static_cast<SessionHandle*>(handle);
+    try {
+        auto step = h->session.step(
+            static_cast<std::size_t>(std::max(1, max_pixels)));
+        h->last_dirty = step.dirty;
+        return step.done ? 1 : 0;
+    } catch (const std::bad_alloc&) {
+        set_error(2, "Out of memory");
+        return -1;
+    } catch (...) {
+        set_error(3, "Unexpected internal error");
+        return -1;
+    }
+}
+
+// Writes the last step's dirty rectangle as x0, y0, x1, y1 (exclusive).
+void fill_session_dirty(void* handle, int* rect4) {
+    if (!handle || !rect4) return;
+    const DirtyRect& d = static_cast<SessionHandle*>(handle)->last_dirty;
+    rect4[0] = d.x0;
+    rect4[1] = d.y0;
+    rect4[2] = d.x1;
+    rect4[3] = d.y1;
+}
+
+const uint8_t* fill_session_canvas(void* handle) {
+    if (!handle) return nullptr;
+    return reinterpret_cast<const uint8_t*>(
+        static_cast<SessionHandle*>(handle)->session.canvas().data());
+}
+
+// The next step ends the fill with stop reason 1.
+void fill_session_cancel(void* handle) {
+    if (handle) static_cast<SessionHandle*>(handle)->cancel.cancel();
+}
+
+int fill_session_stop_reason(void* handle) {
+    if (!handle) return 0;
+    return static_cast<int>(
+        static_cast<SessionHandle*>(handle)->session.stats().stop);
+}
+
+int fill_session_filled_pixels(void* handle) {
+    if (!handle) return 0;
+    return static_cast<int>(
+        static_cast<SessionHandle*>(handle)->session.stats().filled_pixels);
+}
+
+void fill_session_destroy(void* handle) {
+    delete static_cast<SessionHandle*>(handle);
+}
+
 void free_buffer(void* p) {
     std::free(p);
 }
@@ -1,35 +1,139 @@
 #pragma once
 
 #include "image.hpp"
+#include "tile_canvas.hpp"
 
 #include <cstddef>
+#include <cstdint>
 #include <filesystem>
+#include <span>
 #include <vector>
 
 namespace triplefill {
 
+/// Why a fill stopped.
+enum class StopReason {
+    Complete,    ///< The whole region was filled
+    Cancelled,   ///< FillConfig::cancel was cancelled
+    Deadline,    ///< FillConfig::deadline passed
+    PixelBudget, ///< FillConfig::max_pixels were filled
+};
+
+/// True when the library was built with TRIPLEFILL_STATS; otherwise every
+/// FillTelemetry field stays zero and the counting code is compiled out.
+#if defined(TRIPLEFILL_STATS) && TRIPLEFILL_STATS
+inline constexpr bool telemetry_enabled = true;
+#else
+inline constexpr bool telemetry_enabled = false;
+#endif
+
+/// Hot-path counters for diagnosing slow fills (see telemetry_enabled).
+struct FillTelemetry {
+    /// Pixels run through the colour-distance kernel.
+    std::size_t tolerance_evaluations = 0;
+    /// Of those, pixels whose colour's verdict was already memoised; the
+    /// memo hit rate is memo_hits / tolerance_evaluations.
+    std::size_t memo_hits             = 0;
+    /// Unvisited neighbours tested for tolerance, and how many of those
+    /// were out of tolerance.
+    std::size_t neighbour_tests       = 0;
+    std::size_t rejected_neighbours   = 0;
+    std::size_t picker_calls          = 0;
+    /// Bytes stored for intermediate frames: 8 per painted pixel for an
+    /// Animation, a whole canvas per frame for FillSession steps.
+    std::size_t frame_copy_bytes      = 0;
+
+    // Wall time per phase, in seconds:
+    //   setup    - copying the source and preparing scratch
+    //   traverse - the walk or Parallel labelling, including capture
+    //   paint    - a separate painting pass (Parallel, cached regions)
+    //   capture  - copying intermediate frames
+    double setup_seconds    = 0;
+    double traverse_seconds = 0;
+    double paint_seconds    = 0;
+    double capture_seconds  = 0;
+};
+
 struct FillStats {
     std::size_t filled_pixels   = 0;
     std::size_t frames_captured = 0;
+    /// Largest number of entries (4 bytes each) the frontier held at once;
+    /// 0 for Algorithm::Parallel, which has no frontier.
+    std::size_t frontier_peak   = 0;
+    StopReason  stop            = StopReason::Complete;
+    /// Always zero unless telemetry_enabled.
+    FillTelemetry telemetry     = {};
+
+    /// The region was only partly filled.
+    [[nodiscard]] bool truncated() const noexcept {
+        return stop != StopReason::Complete;
+    }
 };
 
+/// The frames of a fill.
+///
+/// Frames are stored as periodic keyframes plus, for every other frame, the
+/// pixels that changed since the frame before it (storage offset and
+/// colour, 8 bytes each). A fill that captures a frame every 1000 pixels of
+/// a 4096² image stores about 8 KB per frame instead of 64 MB.
+///
+/// Keyframes are TileCanvas snapshots of a tiled copy of the latest frame,
+/// so each costs only the 64x64 tiles painted since the one before it, not
+/// a whole image. A new keyframe starts once the pixels changed since the
+/// last one outnumber a quarter of the image, and rebuilding any frame
+/// replays at most that many changes.
+///
+/// The latest frame is also kept whole: final_frame() is free, and a frame
+/// added with its changes costs O(changes). frame(i) rebuilds on demand
+/// into a contiguous cursor image, from the cursor itself when moving
+/// forward, otherwise from the nearest keyframe at or before i. Reading
+/// frames in order costs O(changes) per frame. frame() is not safe to call
+/// concurrently on one Animation.
 class Animation {
 public:
     Animation() = default;
 
-    void reserve(std::size_t n) { frames_.reserve(n); }
-    void add_frame(Image img) { frames_.push_back(std::move(img)); }
+    void reserve(std::size_t n) { deltas_.reserve(n); }
 
-    [[nodiscard]] std::size_t   size()  const noexcept { return frames_.size(); }
-    [[nodiscard]] bool          empty() const noexcept { return frames_.empty(); }
+    /// Append a frame, found by comparing it with the previous one:
+    /// O(pixels). Throws std::runtime_error if its size differs from the
+    /// first frame's.
+    void add_frame(Image img);
 
-    [[nodiscard]] const Image& frame(std::size_t i) const { return frames_.at(i); }
-    [[nodiscard]] const Image& final_frame()        const { return frames_.back(); }
+    /// Append a frame that differs from the previous one only at `changed`,
+    /// storage offsets into img.data() in any order: O(changed). The rvalue
+    /// overload takes `img` as the new latest frame instead of copying the
+    /// changed pixels into it. The layout must match the first frame's.
+    void add_frame(const Image& img, std::span<const std::uint32_t> changed);
+    void add_frame(Image&& img, std::span<const std::uint32_t> changed);
 
-    [[nodiscard]] const std::vector<Image>& frames() const noexcept {
-        return frames_;
+    [[nodiscard]] std::size_t size()  const noexcept { return deltas_.size(); }
+    [[nodiscard]] bool        empty() const noexcept { return deltas_.empty(); }
+
+    /// Frame i, rebuilt if needed. The reference stays valid until the next
+    /// frame() call or change to the animation. Throws std::out_of_range.
+    [[nodiscard]] const Image& frame(std::size_t i) const;
+    [[nodiscard]] const Image& final_frame() const noexcept { return last_; }
+
+    /// Frames stored as snapshots (the latest frame is always whole).
+    [[nodiscard]] std::size_t keyframes() const noexcept {
+        return keyframes_.size();
     }
 
+    /// Bytes held by keyframe tiles (each shared tile counted once), deltas,
+    /// the latest frame and the cursor; O(1). Tiles shared with a copy of
+    /// the animation are counted in both.
+    [[nodiscard]] std::size_t bytes() const noexcept;
+
+    /// Drop frames 0, 2, 4, ..., keeping the latest frame as well when
+    /// size() is odd, so a fill captured every f pixels becomes one every
+    /// 2f. A kept frame takes the changes of the frame dropped before it,
+    /// stored as a delta or, once those paint its tiles densely enough to
+    /// be smaller, as a keyframe. The changes are merged rather than freed,
+    /// so this may save little. With `only_if_smaller`, frames are dropped
+    /// only if that reduces bytes(). Returns whether they were. O(changes).
+    bool thin(bool only_if_smaller = false);
+
     void set_stats(FillStats s) noexcept { stats_ = s; }
     [[nodiscard]] const FillStats& stats() const noexcept { return stats_; }
 
@@ -38,7 +142,36 @@ public:
                    unsigned delay_cs = 4) const;
 
 private:
-    std::vector<Image> frames_;
+    struct Change {
+        std::uint32_t offset;
+        RGBA          color;
+    };
+
+    /// Start the animation with `img` as frame 0.
+    void start(const Image& img);
+
+    /// Bytes of the distinct tiles held by `keyframes` and head_.
+    [[nodiscard]] std::size_t count_tile_bytes(
+        const std::vector<TileCanvas>& keyframes) const;
+
+    /// Record frame size() from `img`, whose changes are `changed`, before
+    /// last_ becomes it.
+    void push(const Image& img, std::span<const std::uint32_t> changed);
+
+    // deltas_[i] turns frame i - 1 into frame i; empty for frame 0.
+    // Keyframe k is frame key_index_[k], a snapshot of head_ at that frame.
+    std::vector<std::vector<Change>> deltas_;
+    std::vector<std::size_t> key_index_;
+    std::vector<TileCanvas>  keyframes_;
+    TileCanvas               head_;          // the latest frame, as tiles
+    std::size_t              since_key_ = 0; // changes since the last keyframe
+                                             // or thin()
+    std::size_t              delta_bytes_ = 0;
+    std::size_t              tile_bytes_  = 0;
+    Image                    last_;
+    mutable Image            cursor_;
+    mutable std::size_t      cursor_index_ = 0;
+    mutable bool             cursor_valid_ = false;
     FillStats stats_;
 };
 
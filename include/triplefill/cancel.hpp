@@ -0,0 +1,37 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+
+namespace triplefill {
+
+/// Shared flag that asks a running fill to stop. Copies share one flag, so
+/// a token can be handed to FillConfig and cancelled from another thread.
+/// A default-constructed token has no flag and is never cancelled.
+class CancelToken {
+public:
+    CancelToken() = default;
+
+    /// A token with a fresh, uncancelled flag.
+    [[nodiscard]] static CancelToken make() {
+        CancelToken t;
+        t.flag_ = std::make_shared<std::atomic<bool>>(false);
+        return t;
+    }
+
+    void cancel() const noexcept {
+        if (flag_) flag_->store(true, std::memory_order_relaxed);
+    }
+
+    [[nodiscard]] bool cancelled() const noexcept {
+        return flag_ && flag_->load(std::memory_order_relaxed);
+    }
+
+    /// True when the token can be cancelled at all.
+    explicit operator bool() const noexcept { return flag_ != nullptr; }
+
+private:
+    std::shared_ptr<std::atomic<bool>> flag_;
+};
+
+} // namespace triplefill
@@ -2,11 +2,10 @@
 
 #include "pixel.hpp"
 #include "point.hpp"
+#include "visited_map.hpp"
 
-#include <cstdint>
 #include <functional>
 #include <variant>
-#include <vector>
 
 namespace triplefill {
 
@@ -46,11 +45,10 @@ using PickerConfig = std::variant<SolidPicker, StripePicker,
 using ColorPickerFn = std::function<RGBA(Point, const RGBA&)>;
 
 /// Build a concrete picker function from a config.
-/// For BorderPicker the fill engine supplies a reference to the visited bitmap
-/// and image dimensions so the picker can inspect neighbour fill state.
+/// For BorderPicker the fill engine supplies a reference to the visited map
+/// so the picker can inspect neighbour fill state.
 ColorPickerFn make_picker(const PickerConfig& cfg);
 ColorPickerFn make_border_picker(const BorderPicker& bp,
-                                 const std::vector<std::uint8_t>& visited,
-                                 unsigned img_w, unsigned img_h);
+                                 const VisitedMap& visited);
 
 } // namespace triplefill
@@ -1,17 +1,29 @@
 #pragma once
 
 #include "animation.hpp"
+#include "cancel.hpp"
 #include "color_picker.hpp"
 #include "image.hpp"
 #include "point.hpp"
+#include "tolerance.hpp"
 
+#include <chrono>
 #include <cstddef>
 #include <functional>
 #include <optional>
+#include <span>
+#include <vector>
 
 namespace triplefill {
 
-enum class Algorithm { BFS, DFS };
+/// BFS and DFS push individual pixels; Scanline pushes one seed per
+/// horizontal run and paints whole runs at a time; Parallel labels the
+/// image in tiles on a thread pool and paints the seed's component.
+enum class Algorithm { BFS, DFS, Scanline, Parallel };
+
+/// Which neighbours of a pixel belong to its region: edge-adjacent only, or
+/// also the diagonals (for anti-aliased or one-pixel-wide line art).
+enum class Connectivity { Four, Eight };
 
 /// Optional progress callback: (pixels_filled, pixels_queued).
 using ProgressFn = std::function<void(std::size_t, std::size_t)>;
@@ -24,13 +36,82 @@ struct FillConfig {
     PickerConfig   picker       = SolidPicker{RGBA{255, 0, 0}};
     std::optional<std::size_t> max_frames{};
     ProgressFn     on_progress{};
+    unsigned       threads      = 0;   // Parallel only; 0 = hardware threads
+
+    // Limits. A fill that hits one stops early and keeps what it painted;
+    // FillStats::stop says which limit ended it. The token and deadline are
+    // polled every stop_check_interval pixels.
+    CancelToken    cancel{};
+    std::optional<std::chrono::steady_clock::time_point> deadline{};
+    std::optional<std::size_t> max_pixels{};
+
+    Connectivity   connectivity = Connectivity::Four;
+
+    // How `tolerance` is measured; see ColorMetric for each metric's range.
+    ColorMetric    metric       = ColorMetric::Hsl;
+
+    // Memory cap for the returned Animation (Animation::bytes()). Whenever
+    // it is passed and thinning frees memory, every other stored frame is
+    // dropped and frames are then captured half as often, so the frames
+    // kept span the whole fill at an even interval. The cap is raised to
+    // the latest frame plus two tiled copies of the image, which any
+    // animation fits by keeping only its final frame, and holds when the
+    // fill returns. Applies to sinks that hold frames (FrameSink::bytes()).
+    std::optional<std::size_t> max_animation_bytes{};
 };
 
+/// Pixels filled between polls of FillConfig::cancel and ::deadline.
+inline constexpr std::size_t stop_check_interval = 4096;
+
 /// Run flood fill on a *copy* of `img` and return an Animation of frames.
 /// The final frame is always appended (the completed fill result).
 ///
-/// Neighbour push order: North, East, South, West.
-/// Pixels are marked visited on push; coloured on pop.
+/// BFS / DFS: neighbour push order is North, East, South, West for
+/// Connectivity::Four, and clockwise from North (N, NE, E, SE, S, SW, W, NW)
+/// for Connectivity::Eight. Pixels are marked visited on push; coloured on
+/// pop.
+///
+/// Scanline: a popped seed is grown into its maximal horizontal run, the run
+/// is marked visited and coloured left to right, then the rows above and
+/// below are scanned for new seeds (over the run, widened by one pixel each
+/// side for Connectivity::Eight). The filled region is identical to
+/// BFS / DFS; only the paint order (and hence intermediate frames and
+/// BorderPicker output) differs. Frames are still captured every
+/// `frame_freq` coloured pixels.
+///
+/// Parallel: the image is split into 256x256 tiles; in-tolerance components
+/// are labelled per tile on `threads` workers, merged across tile seams with
+/// a lock-free union-find, and the seed's component is painted. Only the
+/// final frame is produced (`frame_freq` is ignored) and BorderPicker sees
+/// the complete region. Needs 4 bytes of label storage per pixel and at most
+/// 2^32-1 pixels (throws std::length_error otherwise). The token and
+/// deadline are polled once per tile while labelling; a component larger
+/// than `max_pixels`, or a stop before painting, leaves the image unpainted.
 Animation flood_fill(const Image& img, const FillConfig& cfg);
 
+/// Upper estimate of the bytes flood_fill(img, cfg) allocates for a w x h
+/// image, the source not included, if the region covers the whole image:
+/// the working canvas, visited map, frontier, tolerance mask and colour
+/// memo (or Parallel's labels), plus the Animation. Use it to choose
+/// max_animation_bytes or max_frames before running. A comb-shaped region
+/// can grow the frontier past the estimate.
+[[nodiscard]] std::size_t estimate_fill_memory(unsigned w, unsigned h,
+                                               const FillConfig& cfg);
+
+/// Run one fill per config against the same source image. Result i equals
+/// `flood_fill(img, cfgs[i])`.
+///
+/// Scratch (visited map, tolerance masks) is shared between fills. When a
+/// final-frame-only fill (`frame_freq <= 0`, no limits set, and not a
+/// BorderPicker unless the algorithm is Parallel) has a seed inside a region
+/// already computed for the same seed colour, tolerance, connectivity and
+/// metric, the traversal is skipped and the picker is applied to the cached
+/// region.
+///
+/// `threads` > 1 runs independent fills concurrently (0 = one per hardware
+/// thread); each config's own `threads` still applies to Parallel fills.
+std::vector<Animation> flood_fill_many(const Image& img,
+                                       std::span<const FillConfig> cfgs,
+                                       unsigned threads = 1);
+
 } // namespace triplefill
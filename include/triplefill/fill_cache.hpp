@@ -0,0 +1,85 @@
+#pragma once
+
+#include "animation.hpp"
+#include "fill.hpp"
+#include "image.hpp"
+#include "pixel.hpp"
+#include "visited_map.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <list>
+
+namespace triplefill {
+
+/// 64-bit digest of an image's size and pixels. Layout does not matter:
+/// an image and its converted() copy hash the same.
+[[nodiscard]] std::uint64_t image_digest(const Image& img);
+
+/// Least-recently-used cache of fill regions in front of flood_fill, for
+/// callers that fill the same image again and again (a paint-bucket tool
+/// trying pickers on one region).
+///
+/// A region is stored as a 1-bit-per-pixel mask, keyed by image digest,
+/// seed colour, tolerance, connectivity and metric, and is found by any
+/// seed inside it. A digest match is only trusted if the image size and a
+/// 16x16 grid of sampled pixels match too. When a final-frame-only config
+/// (the same rule as flood_fill_many) hits, the traversal is skipped and
+/// only the picker is applied. Other configs always traverse; their
+/// complete regions are still stored.
+///
+/// The masks are bounded by `max_bytes`; the least recently used are
+/// evicted first. Not thread-safe.
+class FillCache {
+public:
+    explicit FillCache(std::size_t max_bytes = std::size_t{64} << 20)
+        : max_bytes_(max_bytes) {}
+
+    /// Equal to flood_fill(img, cfg).
+    Animation fill(const Image& img, const FillConfig& cfg) {
+        return fill(img, image_digest(img), cfg);
+    }
+
+    /// As above with `digest == image_digest(img)` precomputed, so an image
+    /// filled repeatedly is hashed once.
+    Animation fill(const Image& img, std::uint64_t digest,
+                   const FillConfig& cfg);
+
+    [[nodiscard]] std::size_t size()      const noexcept { return entries_.size(); }
+    [[nodiscard]] std::size_t bytes()     const noexcept { return bytes_; }
+    [[nodiscard]] std::size_t max_bytes() const noexcept { return max_bytes_; }
+    /// Fills answered from a stored region.
+    [[nodiscard]] std::size_t hits()      const noexcept { return hits_; }
+    /// Fills that traversed the image.
+    [[nodiscard]] std::size_t misses()    const noexcept { return misses_; }
+
+    void clear() noexcept {
+        entries_.clear();
+        bytes_ = 0;
+    }
+
+private:
+    struct Entry {
+        std::uint64_t digest;
+        std::uint64_t sample; // of the pixels on the check grid
+        RGBA          seed_color;
+        double        tolerance;
+        Connectivity  connectivity;
+        ColorMetric   metric;
+        VisitedMap    region;
+        std::size_t   count;
+    };
+
+    /// The entry for `img` whose region holds cfg.seed, moved to the front.
+    Entry* find(const Image& img, std::uint64_t digest, std::uint64_t sample,
+                const RGBA& seed_color, const FillConfig& cfg);
+    void insert(Entry entry);
+
+    std::list<Entry> entries_; // most recently used first
+    std::size_t max_bytes_;
+    std::size_t bytes_  = 0;
+    std::size_t hits_   = 0;
+    std::size_t misses_ = 0;
+};
+
+} // namespace triplefill
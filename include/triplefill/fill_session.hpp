@@ -0,0 +1,70 @@
+#pragma once
+
+#include "animation.hpp"
+#include "fill.hpp"
+#include "image.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace triplefill {
+
+/// Bounding box [x0, x1) x [y0, y1) of the pixels painted by one step.
+struct DirtyRect {
+    int x0 = 0;
+    int y0 = 0;
+    int x1 = 0;
+    int y1 = 0;
+
+    [[nodiscard]] bool empty() const noexcept { return x0 >= x1 || y0 >= y1; }
+};
+
+/// What one FillSession::step painted.
+struct FillStep {
+    std::size_t        painted = 0;  ///< Pixels coloured by this step
+    DirtyRect          dirty;        ///< Their bounding box on canvas()
+    std::vector<Image> frames;       ///< Frames captured during this step
+    bool               done = false; ///< The fill is complete
+};
+
+/// A flood fill that runs in caller-sized increments.
+///
+/// The session owns the canvas, visited map and frontier. Each step()
+/// colours at most `max_pixels` more pixels and hands back only what
+/// changed, so a UI can render between steps and stream frames without the
+/// session retaining them. Stepping a session to completion paints exactly
+/// what flood_fill(img, cfg) would, with the same intermediate frames
+/// (split across steps) and the same canvas as its final frame.
+///
+/// The limits in FillConfig apply across steps; a session that hits one is
+/// done, and stats().stop says which. Algorithm::Parallel cannot be paused;
+/// its first step completes the fill. A seed outside the image gives a
+/// session that is already done.
+class FillSession {
+public:
+    /// `img` must outlive the session; it is read lazily as the fill grows.
+    /// Throws std::length_error for images too large for the frontier.
+    FillSession(const Image& img, const FillConfig& cfg);
+    ~FillSession();
+
+    FillSession(FillSession&&) noexcept;
+    FillSession& operator=(FillSession&&) noexcept;
+
+    /// Colour up to `max_pixels` more pixels (at least one, unless done).
+    FillStep step(std::size_t max_pixels);
+
+    [[nodiscard]] bool done() const noexcept;
+
+    /// The canvas as painted so far.
+    [[nodiscard]] const Image& canvas() const noexcept;
+
+    /// Totals so far; frames_captured counts frames handed out by step().
+    [[nodiscard]] FillStats stats() const noexcept;
+
+private:
+    struct State;
+    std::unique_ptr<State> state_;
+};
+
+} // namespace triplefill
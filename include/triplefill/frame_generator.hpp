@@ -0,0 +1,112 @@
+#pragma once
+
+#include "fill.hpp"
+#include "image.hpp"
+
+#include <coroutine>
+#include <exception>
+#include <filesystem>
+#include <iterator>
+#include <utility>
+
+namespace triplefill {
+
+/// Single-pass range of frames produced by a coroutine. Each element is a
+/// reference to the producer's canvas, valid until the iterator advances;
+/// copy it to keep it.
+class FrameGenerator {
+public:
+    struct promise_type {
+        const Image*       current = nullptr;
+        std::exception_ptr error;
+
+        FrameGenerator get_return_object() noexcept {
+            return FrameGenerator{
+                std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(const Image& img) noexcept {
+            current = &img;
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept {
+            error = std::current_exception();
+        }
+    };
+
+    class iterator {
+    public:
+        using iterator_concept = std::input_iterator_tag;
+        using value_type       = Image;
+        using difference_type  = std::ptrdiff_t;
+
+        iterator() = default;
+
+        const Image& operator*() const { return *h_.promise().current; }
+        const Image* operator->() const { return h_.promise().current; }
+
+        iterator& operator++() {
+            resume(h_);
+            return *this;
+        }
+        void operator++(int) { ++*this; }
+
+        bool operator==(std::default_sentinel_t) const noexcept {
+            return !h_ || h_.done();
+        }
+
+    private:
+        friend class FrameGenerator;
+        explicit iterator(std::coroutine_handle<promise_type> h) : h_(h) {}
+
+        std::coroutine_handle<promise_type> h_;
+    };
+
+    FrameGenerator(FrameGenerator&& other) noexcept
+        : h_(std::exchange(other.h_, {})) {}
+    FrameGenerator& operator=(FrameGenerator&& other) noexcept {
+        if (this != &other) {
+            if (h_) h_.destroy();
+            h_ = std::exchange(other.h_, {});
+        }
+        return *this;
+    }
+    ~FrameGenerator() {
+        if (h_) h_.destroy();
+    }
+
+    /// Runs the producer to its first frame; call once.
+    iterator begin() {
+        resume(h_);
+        return iterator{h_};
+    }
+    std::default_sentinel_t end() const noexcept { return {}; }
+
+private:
+    explicit FrameGenerator(std::coroutine_handle<promise_type> h) : h_(h) {}
+
+    static void resume(std::coroutine_handle<promise_type> h) {
+        h.resume();
+        if (h.promise().error) std::rethrow_exception(h.promise().error);
+    }
+
+    std::coroutine_handle<promise_type> h_;
+};
+
+/// Lazily run flood_fill: yields the frames flood_fill(img, cfg) would
+/// store, in order, as the fill reaches each `frame_freq` boundary, then
+/// the final frame. Every element is a view of the one working canvas, so
+/// no frame is copied and memory stays O(image) however many frames there
+/// are. Nothing is yielded for a seed outside the image. `img` must
+/// outlive the generator.
+[[nodiscard]] FrameGenerator flood_fill_frames(const Image& img,
+                                               FillConfig cfg);
+
+/// Encode frames into an animated GIF as they are produced. Throws
+/// std::runtime_error if there are no frames or the file cannot be written.
+void write_gif(const std::filesystem::path& path, FrameGenerator frames,
+               unsigned delay_cs = 4);
+
+} // namespace triplefill
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "animation.hpp"
+#include "fill.hpp"
+#include "image.hpp"
+#include "pixel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace triplefill {
+
+/// Receives the frames of a fill as they are captured, so a fill with any
+/// number of frames needs O(image) memory (see flood_fill(img, cfg, sink)).
+/// An Animation is one destination (AnimationSink); the others below write
+/// to disk or a pipe. Derive from it to handle frames yourself.
+class FrameSink {
+public:
+    /// Storage offsets into canvas.data() painted since the previous frame,
+    /// in any order; absent when the fill did not track them.
+    using Changes = std::optional<std::span<const std::uint32_t>>;
+
+    virtual ~FrameSink() = default;
+
+    /// Whether the fill should track Changes for this sink, at 4 bytes per
+    /// pixel painted between frames.
+    [[nodiscard]] virtual bool wants_changes() const noexcept { return false; }
+
+    /// An intermediate frame. `canvas` is the fill's working canvas, valid
+    /// only for the call.
+    virtual void frame(const Image& canvas, Changes changed) = 0;
+
+    /// The final frame, sent once at the end of every fill. The canvas is
+    /// not used again, so the sink may keep it. Defaults to frame().
+    virtual void final_frame(Image&& canvas, Changes changed) {
+        frame(canvas, changed);
+    }
+
+    /// Bytes of frames the sink holds in memory, checked against
+    /// FillConfig::max_animation_bytes after every second frame and after
+    /// the final one. Zero for sinks that hold none, which are never
+    /// thinned.
+    [[nodiscard]] virtual std::size_t bytes() const noexcept { return 0; }
+
+    /// Drop frames 0, 2, 4, ... of those received, keeping the latest, and
+    /// return true; with `only_if_smaller`, only if that reduces bytes().
+    /// After a thin during the fill, frames are sent half as often.
+    virtual bool thin(bool only_if_smaller) {
+        (void)only_if_smaller;
+        return false;
+    }
+};
+
+/// Appends frames to an Animation, which stores only what changed.
+class AnimationSink final : public FrameSink {
+public:
+    explicit AnimationSink(Animation& anim) noexcept : anim_(anim) {}
+
+    bool wants_changes() const noexcept override { return true; }
+    void frame(const Image& canvas, Changes changed) override;
+    void final_frame(Image&& canvas, Changes changed) override;
+    std::size_t bytes() const noexcept override { return anim_.bytes(); }
+    bool thin(bool only_if_smaller) override {
+        return anim_.thin(only_if_smaller);
+    }
+
+private:
+    Animation& anim_;
+};
+
+/// Encodes frames into an animated GIF as they arrive. The file is created
+/// on the first frame and completed by close() or the destructor.
+class GifSink final : public FrameSink {
+public:
+    explicit GifSink(std::filesystem::path path, unsigned delay_cs = 4);
+    ~GifSink() override;
+
+    GifSink(const GifSink&) = delete;
+    GifSink& operator=(const GifSink&) = delete;
+
+    /// Throws std::runtime_error if the file cannot be written.
+    void frame(const Image& canvas, Changes changed) override;
+
+    /// Complete the file. Throws std::runtime_error if no frame was sent.
+    void close();
+
+    [[nodiscard]] std::size_t frames() const noexcept { return frames_; }
+
+private:
+    class Writer;
+
+    std::filesystem::path   path_;
+    unsigned                delay_cs_;
+    std::size_t             frames_ = 0;
+    std::unique_ptr<Writer> writer_;
+};
+
+/// Writes frame i to dir / (prefix + i zero-padded to 5 digits + ".png").
+/// The directory must exist.
+class PngSequenceSink final : public FrameSink {
+public:
+    explicit PngSequenceSink(std::filesystem::path dir,
+                             std::string prefix = "frame_");
+
+    void frame(const Image& canvas, Changes changed) override;
+
+    [[nodiscard]] std::size_t frames() const noexcept { return frames_; }
+
+private:
+    std::filesystem::path dir_;
+    std::string           prefix_;
+    std::size_t           frames_ = 0;
+};
+
+/// Writes each frame's pixels to `out` as row-major RGBA with no header,
+/// as rawvideo tools read from a pipe (for ffmpeg: -f rawvideo -pix_fmt
+/// rgba -s WxH -i -). Throws std::runtime_error when a write fails.
+class RawSink final : public FrameSink {
+public:
+    explicit RawSink(std::ostream& out) noexcept : out_(out) {}
+
+    void frame(const Image& canvas, Changes changed) override;
+
+    [[nodiscard]] std::size_t frames() const noexcept { return frames_; }
+
+private:
+    std::ostream&     out_;
+    std::size_t       frames_ = 0;
+    std::vector<RGBA> row_; // a row of a tiled frame, gathered
+};
+
+/// flood_fill(img, cfg), sending each frame to `sink` as it is captured
+/// instead of storing it. Returns the fill's stats; frames_captured counts
+/// the frames sent, the final one included, less those dropped by thin().
+/// Nothing is sent for a seed outside the image.
+FillStats flood_fill(const Image& img, const FillConfig& cfg, FrameSink& sink);
+
+} // namespace triplefill
@@ -2,6 +2,7 @@
 
 #include "pixel.hpp"
 
+#include <algorithm>
 #include <cassert>
 #include <cstdint>
 #include <filesystem>
@@ -9,45 +10,88 @@
 
 namespace triplefill {
 
+/// Pixel storage order of an Image.
+enum class Layout {
+    /// Rows one after another; the order PNG and GIF use.
+    RowMajor,
+    /// 64x64 blocks, row-major within each block and between blocks. A
+    /// vertical step stays inside a 16 KB block, so fills on very wide
+    /// images keep their N/S neighbours in cache.
+    Tiled,
+};
+
 class Image {
 public:
+    static constexpr unsigned tile_shift = 6;
+    static constexpr unsigned tile_size  = 1u << tile_shift;
+
     Image() noexcept = default;
 
-    Image(unsigned w, unsigned h)
-        : w_(w), h_(h), pixels_(static_cast<std::size_t>(w) * h) {}
+    Image(unsigned w, unsigned h, Layout layout = Layout::RowMajor)
+        : Image(w, h, RGBA{}, layout) {}
 
-    Image(unsigned w, unsigned h, RGBA fill)
-        : w_(w), h_(h), pixels_(static_cast<std::size_t>(w) * h, fill) {}
+    Image(unsigned w, unsigned h, RGBA fill, Layout layout = Layout::RowMajor);
 
     [[nodiscard]] unsigned width()  const noexcept { return w_; }
     [[nodiscard]] unsigned height() const noexcept { return h_; }
     [[nodiscard]] bool     empty()  const noexcept { return pixels_.empty(); }
+    [[nodiscard]] Layout   layout() const noexcept { return layout_; }
 
     RGBA& at(unsigned x, unsigned y) {
         assert(x < w_ && y < h_);
-        return pixels_[static_cast<std::size_t>(y) * w_ + x];
+        return pixels_[offset(x, y)];
     }
 
     const RGBA& at(unsigned x, unsigned y) const {
         assert(x < w_ && y < h_);
-        return pixels_[static_cast<std::size_t>(y) * w_ + x];
+        return pixels_[offset(x, y)];
     }
 
+    /// Number of pixels from (x, y) rightwards that are contiguous in
+    /// storage: the rest of the row, or of the block row when tiled.
+    [[nodiscard]] unsigned contiguous_run(unsigned x, unsigned y) const noexcept {
+        assert(x < w_ && y < h_);
+        (void)y;
+        if (layout_ == Layout::RowMajor) return w_ - x;
+        return std::min(tile_size - (x & (tile_size - 1)), w_ - x);
+    }
+
+    /// Copy of this image in `layout`.
+    [[nodiscard]] Image converted(Layout layout) const;
+
+    /// Raw storage in layout() order. For a tiled image this includes the
+    /// padding of partial edge blocks; convert to Layout::RowMajor before
+    /// handing pixels to code that expects PNG order.
     RGBA*       data()       noexcept { return pixels_.data(); }
     const RGBA* data() const noexcept { return pixels_.data(); }
 
+    /// width() * height(), independent of layout.
     [[nodiscard]] std::size_t pixel_count() const noexcept {
-        return pixels_.size();
+        return static_cast<std::size_t>(w_) * h_;
     }
 
-    bool operator==(const Image&) const = default;
+    /// Equal size and pixels; the layouts may differ.
+    bool operator==(const Image& other) const;
 
 private:
+    [[nodiscard]] std::size_t offset(unsigned x, unsigned y) const noexcept {
+        if (layout_ == Layout::RowMajor)
+            return static_cast<std::size_t>(y) * w_ + x;
+        const std::size_t tile =
+            static_cast<std::size_t>(y >> tile_shift) * tiles_x_ +
+            (x >> tile_shift);
+        return (tile << (2 * tile_shift)) +
+               ((y & (tile_size - 1)) << tile_shift) + (x & (tile_size - 1));
+    }
+
     unsigned w_ = 0;
     unsigned h_ = 0;
+    Layout   layout_  = Layout::RowMajor;
+    unsigned tiles_x_ = 0;
     std::vector<RGBA> pixels_;
 };
 
+/// PNG files are row-major; save_png converts tiled images on the way out.
 [[nodiscard]] Image load_png(const std::filesystem::path& path);
 void save_png(const std::filesystem::path& path, const Image& img);
 
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "animation.hpp"
+#include "fill.hpp"
+
+#include <cstddef>
+#include <filesystem>
+
+namespace triplefill {
+
+/// Side of the square tiles flood_fill_file pages in and out.
+inline constexpr unsigned paged_tile_size = 256;
+
+/// Flood fill an image file too large to hold in memory.
+///
+/// `input` holds width x height RGBA pixels, row-major, 4 bytes each, with
+/// no header. It is copied to `output` (unless they are the same file) and
+/// the fill is applied to `output` in place. At most `max_resident_tiles`
+/// paged_tile_size² tiles are held in memory. When another tile is needed,
+/// the least recently used one is written back if it was painted. The
+/// default, 0, keeps three rows of tiles: a Scanline run and the rows above
+/// and below it then never page. Fewer tiles thrash on wide regions. The
+/// visited map (1 bit per pixel) and frontier stay in memory: about 200 MB
+/// for a 40000² mosaic whose pixels take 6.4 GB.
+///
+/// The same walks as flood_fill run over the tiles, so the file ends up
+/// equal to the final frame of flood_fill(img, cfg). Algorithm::Parallel
+/// runs as Scanline, which also pages the least. Frames are not captured.
+/// The limits in FillConfig apply. A seed outside the image leaves the
+/// copy unpainted.
+///
+/// Throws std::runtime_error on I/O errors or a file of the wrong size, and
+/// std::length_error for images too large for the frontier.
+FillStats flood_fill_file(const std::filesystem::path& input,
+                          const std::filesystem::path& output,
+                          unsigned width, unsigned height,
+                          const FillConfig& cfg,
+                          std::size_t max_resident_tiles = 0);
+
+} // namespace triplefill
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "animation.hpp"
+#include "fill.hpp"
+#include "image.hpp"
+#include "pixel.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+namespace triplefill {
+
+/// An image converted once to HSL, for sessions that fill the same image
+/// many times (a paint-bucket tool, a tolerance slider without a map).
+///
+/// Hue (as h / 360), saturation and lightness are kept as three float
+/// planes, structure-of-arrays, each row starting on a 64-byte boundary.
+/// The HSL tolerance test over a run of pixels is then three loads and a
+/// few multiplies per pixel instead of an RGB to HSL conversion with two
+/// divisions. Planes take 12 bytes per pixel on top of a row-major copy of
+/// the image.
+///
+/// Immutable once built, so it can be shared between threads.
+class PreparedImage {
+public:
+    static constexpr std::size_t alignment = 64;
+
+    PreparedImage() = default;
+
+    /// Convert `img` on `threads` threads (0 = one per hardware thread),
+    /// a band of rows each.
+    explicit PreparedImage(const Image& img, unsigned threads = 0);
+
+    [[nodiscard]] const Image& image()  const noexcept { return img_; }
+    [[nodiscard]] unsigned     width()  const noexcept { return img_.width(); }
+    [[nodiscard]] unsigned     height() const noexcept { return img_.height(); }
+    [[nodiscard]] bool         empty()  const noexcept { return img_.empty(); }
+
+    /// Floats per plane row; a multiple of alignment / sizeof(float).
+    [[nodiscard]] std::size_t stride() const noexcept { return stride_; }
+
+    /// Row y of each plane. Hue is in [0, 1), the others in [0, 1].
+    [[nodiscard]] const float* hue(unsigned y) const noexcept {
+        return plane(0, y);
+    }
+    [[nodiscard]] const float* saturation(unsigned y) const noexcept {
+        return plane(1, y);
+    }
+    [[nodiscard]] const float* lightness(unsigned y) const noexcept {
+        return plane(2, y);
+    }
+
+    /// Bytes held by the planes and the pixel copy.
+    [[nodiscard]] std::size_t bytes() const noexcept {
+        return 3 * stride_ * height() * sizeof(float) +
+               img_.pixel_count() * sizeof(RGBA);
+    }
+
+    /// `color_within` over pixels [x, x + n) of row y with ColorMetric::Hsl,
+    /// read from the planes: sets bit i % 64 of out[i / 64] for each pixel
+    /// x + i within tolerance. Pixels within 1e-5 of tolerance² are
+    /// re-tested with color_distance, so verdicts agree with it exactly.
+    void within(unsigned x, unsigned y, std::size_t n, const RGBA& seed,
+                double tolerance, std::uint64_t* out) const noexcept;
+
+private:
+    struct AlignedFree {
+        void operator()(float* p) const noexcept;
+    };
+
+    [[nodiscard]] float* plane(unsigned k, unsigned y) const noexcept {
+        return planes_.get() + (static_cast<std::size_t>(k) * height() + y) *
+                                   stride_;
+    }
+
+    Image       img_; // row-major
+    std::size_t stride_ = 0;
+    std::unique_ptr<float[], AlignedFree> planes_;
+};
+
+/// flood_fill(prepared.image(), cfg), with ColorMetric::Hsl tolerance tests
+/// read from the planes. Other metrics fill the image directly.
+Animation flood_fill(const PreparedImage& prepared, const FillConfig& cfg);
+
+} // namespace triplefill
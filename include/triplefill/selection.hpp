@@ -0,0 +1,60 @@
+#pragma once
+
+#include "animation.hpp"
+#include "fill.hpp"
+#include "image.hpp"
+#include "point.hpp"
+#include "visited_map.hpp"
+
+#include <cstddef>
+#include <optional>
+#include <vector>
+
+namespace triplefill {
+
+/// Pixels [x0, x1] of row y (inclusive, like VisitedMap::set_run).
+struct Span {
+    int y  = 0;
+    int x0 = 0;
+    int x1 = 0;
+
+    [[nodiscard]] std::size_t length() const noexcept {
+        return static_cast<std::size_t>(x1 - x0) + 1;
+    }
+
+    bool operator==(const Span&) const = default;
+};
+
+/// A flood-fill region as row spans.
+struct Selection {
+    /// Maximal runs, sorted by row and then by x0. Spans on a row never
+    /// overlap or touch.
+    std::vector<Span> spans;
+    std::size_t       pixel_count = 0;
+    StopReason        stop        = StopReason::Complete;
+    /// The region as a bitmask; only set when requested.
+    std::optional<VisitedMap> mask;
+
+    [[nodiscard]] bool truncated() const noexcept {
+        return stop != StopReason::Complete;
+    }
+
+    /// Binary search over `spans`.
+    [[nodiscard]] bool contains(Point p) const noexcept;
+};
+
+/// The region flood_fill(img, cfg) would paint, without copying the image
+/// or calling the picker: only cfg.seed, tolerance, metric, connectivity,
+/// on_progress and the limits apply. The region is always found with the
+/// Scanline walk, whatever cfg.algorithm says. With `with_mask` the visited
+/// map is returned too, at 1 bit per pixel.
+///
+/// A limit that stops the walk leaves a partial selection whose spans are
+/// still sorted, polled as flood_fill polls them; max_pixels is met exactly
+/// by shortening the last span, which keeps the seed if it is the seed's
+/// run. A seed outside the image gives an empty selection. Throws
+/// std::length_error for images too large for the frontier.
+Selection flood_select(const Image& img, const FillConfig& cfg,
+                       bool with_mask = false);
+
+} // namespace triplefill
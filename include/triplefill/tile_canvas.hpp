@@ -0,0 +1,97 @@
+#pragma once
+
+#include "image.hpp"
+#include "pixel.hpp"
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+namespace triplefill {
+
+/// Pixels in 64x64 tiles shared copy-on-write between copies of a canvas.
+///
+/// Copying a TileCanvas is a snapshot: it copies one pointer per tile
+/// (about 4K of them for a 4096² image) instead of the pixels, and a tile
+/// is duplicated the first time a canvas that shares it is written. A
+/// series of snapshots of a canvas being painted therefore costs only the
+/// tiles painted between them. to_image() and copy_to() give contiguous
+/// pixels for code that needs an Image.
+///
+/// Copies may be used from different threads; a shared tile is never
+/// written in place.
+class TileCanvas {
+public:
+    static constexpr unsigned    tile_shift = Image::tile_shift;
+    static constexpr unsigned    tile_size  = Image::tile_size;
+    static constexpr std::size_t tile_bytes =
+        std::size_t{tile_size} * tile_size * sizeof(RGBA);
+
+    TileCanvas() = default;
+    explicit TileCanvas(const Image& img);
+
+    [[nodiscard]] unsigned width()  const noexcept { return w_; }
+    [[nodiscard]] unsigned height() const noexcept { return h_; }
+    [[nodiscard]] bool     empty()  const noexcept { return tiles_.empty(); }
+
+    [[nodiscard]] const RGBA& at(unsigned x, unsigned y) const noexcept {
+        return tiles_[tile_of(x, y)]->px[within(x, y)];
+    }
+
+    /// Writable pixel (x, y); duplicates its tile first if it is shared.
+    [[nodiscard]] RGBA& write(unsigned x, unsigned y) {
+        return writable(tile_of(x, y)).px[within(x, y)];
+    }
+
+    /// write() by storage offset into an image of this size in `layout`.
+    /// Tiled storage is ordered as the tiles here, so no division is needed.
+    [[nodiscard]] RGBA& write(std::size_t offset, Layout layout) {
+        if (layout == Layout::Tiled)
+            return writable(offset >> (2 * tile_shift))
+                .px[offset & (tile_size * tile_size - 1)];
+        return write(static_cast<unsigned>(offset % w_),
+                     static_cast<unsigned>(offset / w_));
+    }
+
+    /// Contiguous copy in `layout`.
+    [[nodiscard]] Image to_image(Layout layout = Layout::RowMajor) const;
+
+    /// Overwrite `out`, an image of the same size in any layout.
+    void copy_to(Image& out) const;
+
+    /// Number of tiles, and how many of them another canvas also holds.
+    [[nodiscard]] std::size_t tile_count()   const noexcept { return tiles_.size(); }
+    [[nodiscard]] std::size_t shared_tiles() const noexcept;
+
+    /// Tiles write() has duplicated so far.
+    [[nodiscard]] std::size_t copied_tiles() const noexcept { return copies_; }
+
+    /// Call fn(id) for each tile; equal ids are the same shared storage.
+    template <class Fn>
+    void for_each_tile(Fn&& fn) const {
+        for (const auto& t : tiles_) fn(static_cast<const void*>(t.get()));
+    }
+
+private:
+    struct Tile {
+        RGBA px[tile_size * tile_size];
+    };
+
+    [[nodiscard]] std::size_t tile_of(unsigned x, unsigned y) const noexcept {
+        return static_cast<std::size_t>(y >> tile_shift) * tiles_x_ +
+               (x >> tile_shift);
+    }
+    [[nodiscard]] static unsigned within(unsigned x, unsigned y) noexcept {
+        return ((y & (tile_size - 1)) << tile_shift) | (x & (tile_size - 1));
+    }
+
+    Tile& writable(std::size_t t);
+
+    unsigned w_       = 0;
+    unsigned h_       = 0;
+    unsigned tiles_x_ = 0;
+    std::size_t copies_ = 0;
+    std::vector<std::shared_ptr<Tile>> tiles_;
+};
+
+} // namespace triplefill
@@ -2,6 +2,9 @@
 
 #include "pixel.hpp"
 
+#include <cstddef>
+#include <cstdint>
+
 namespace triplefill {
 
 struct HSL {
@@ -18,6 +21,59 @@ RGBA hsl_to_rgb(const HSL& c, std::uint8_t a = 255) noexcept;
 /// Result is sqrt(dh^2 + ds^2 + dl^2), range roughly [0, ~1.22].
 double color_distance(const RGBA& a, const RGBA& b) noexcept;
 
+/// Same metric on already-converted colours; `color_distance(a, b)` is
+/// exactly `color_distance(rgb_to_hsl(a), rgb_to_hsl(b))`.
+double color_distance(const HSL& a, const HSL& b) noexcept;
+
+/// How "similar to the seed" is measured. Tolerances are in each metric's
+/// own units:
+///   Hsl              - color_distance above; range [0, ~1.22]. The default.
+///   Rgb              - Euclidean over R, G, B scaled to [0, 1]; [0, sqrt(3)].
+///   MaxChannel       - largest of |dR|, |dG|, |dB| scaled to [0, 1]; [0, 1].
+///   PremultipliedRgb - the original RGBAPixel::distanceTo: squared
+///                      differences of alpha-premultiplied channels, where a
+///                      change in alpha counts too; not square-rooted,
+///                      [0, 12]. The only metric that reads alpha.
+///   Lab              - CIE76 ΔE in CIELAB (sRGB, D65); [0, ~260], with 2.3
+///                      about a just-noticeable difference.
+enum class ColorMetric { Hsl, Rgb, MaxChannel, PremultipliedRgb, Lab };
+
+/// Distance between two colours under `metric`; the definition
+/// color_within agrees with. ColorMetric::Hsl is color_distance(a, b).
+double color_distance(const RGBA& a, const RGBA& b,
+                      ColorMetric metric) noexcept;
+
+/// Batched `color_distance(seed, px[i], metric) <= tolerance` for i in
+/// [0, n): sets bit i % 64 of out[i / 64] for each pixel within tolerance
+/// and leaves the other bits alone.
+///
+/// Runs the widest SIMD kernel the build targets (AVX2, SSE4.1 / SSE2,
+/// NEON, WASM SIMD128; otherwise the scalar reference, color_distance
+/// itself). Each metric has its own kernel over single-precision lanes:
+///   Hsl     - squared distance with no sqrt or fmod; blocks whose lightness
+///             alone is out of tolerance are skipped. Pixels within 1e-5 of
+///             tolerance² are re-tested with the scalar reference.
+///   Rgb, MaxChannel
+///           - integer keys (sum of squared differences, largest
+///             difference), compared against the largest key within
+///             tolerance: exact, a few operations per pixel.
+///   PremultipliedRgb
+///           - as above with keys beyond float's exact range; pixels within
+///             1e-6 of the limit are re-tested with the scalar reference.
+///   Lab     - scalar reference only.
+/// Verdicts agree with color_distance exactly, including at the threshold.
+void color_within(const RGBA* px, std::size_t n, const RGBA& seed,
+                  double tolerance, std::uint64_t* out,
+                  ColorMetric metric = ColorMetric::Hsl) noexcept;
+
+/// Whether a metric's verdicts are worth memoising per RGB colour: they do
+/// not depend on alpha, and the kernel costs more than a table lookup.
+[[nodiscard]] bool color_metric_memoised(ColorMetric metric) noexcept;
+
+/// Name of the kernel color_within uses ("avx2", "sse4.1", "sse2", "neon",
+/// "simd128" or "scalar").
+[[nodiscard]] const char* color_within_kernel() noexcept;
+
 /// Clamp-add brightness delta to an RGBA color (operates in HSL space).
 RGBA adjust_luminance(const RGBA& c, double delta) noexcept;
 
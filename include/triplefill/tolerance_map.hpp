@@ -0,0 +1,97 @@
+#pragma once
+
+#include "animation.hpp"
+#include "fill.hpp"
+#include "image.hpp"
+#include "point.hpp"
+#include "visited_map.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace triplefill {
+
+/// For every pixel, the smallest tolerance at which a fill from one seed
+/// reaches it, quantised to 16-bit levels.
+///
+/// The region of flood_fill at tolerance t is the seed's connected component
+/// of pixels with `color_distance(seed, p) <= t`, so a pixel joins at the
+/// largest distance on its best path from the seed. Once the map is built,
+/// the region for any tolerance is a threshold over it: a tolerance slider
+/// scans 2 bytes per pixel per position instead of re-filling.
+///
+/// Level L stands for tolerance L * step, step = max_tolerance / 65535. A
+/// pixel's level is the smallest L whose tolerance covers its joining
+/// distance, so region(t) is exactly flood_fill's region at t rounded down
+/// to a level. It differs from the region at t itself only when some
+/// distance falls between the two, less than one step (about 2.3e-5) apart.
+///
+/// Distances are ColorMetric::Hsl's, the metric the 1.5 range is sized for.
+class ToleranceMap {
+public:
+    /// Largest possible color_distance: half the hue circle plus full
+    /// saturation and lightness differences.
+    static constexpr double   max_tolerance = 1.5;
+    static constexpr unsigned max_level     = 65535;
+    static constexpr double   step          = max_tolerance / max_level;
+
+    ToleranceMap() = default;
+
+    [[nodiscard]] unsigned width()  const noexcept { return w_; }
+    [[nodiscard]] unsigned height() const noexcept { return h_; }
+    [[nodiscard]] Point    seed()   const noexcept { return seed_; }
+    [[nodiscard]] bool     empty()  const noexcept { return levels_.empty(); }
+
+    /// Level at which (x, y) joins; 0 for the seed.
+    [[nodiscard]] std::uint16_t level(unsigned x, unsigned y) const noexcept {
+        return levels_[static_cast<std::size_t>(y) * w_ + x];
+    }
+
+    /// Row-major levels, width() * height() of them.
+    [[nodiscard]] const std::uint16_t* data() const noexcept {
+        return levels_.data();
+    }
+
+    /// Tolerance of level L.
+    [[nodiscard]] static double tolerance_of(unsigned level) noexcept {
+        return level * step;
+    }
+
+    /// Largest level whose tolerance is <= t, or -1 when t < 0.
+    [[nodiscard]] static int level_for(double tolerance) noexcept;
+
+    /// Pixels filled at tolerance t. Like flood_fill, a negative or NaN
+    /// tolerance still fills the seed.
+    [[nodiscard]] std::size_t count(double tolerance) const noexcept;
+
+    /// The region filled at tolerance t; only the seed when t < 0 or NaN.
+    [[nodiscard]] VisitedMap region(double tolerance) const;
+
+    /// Final frame of flood_fill(img, cfg) at cfg.tolerance, without a
+    /// traversal: the picker is applied to region(cfg.tolerance), as
+    /// flood_fill_many does for cached regions. `img` must be the mapped
+    /// image; cfg.seed, connectivity, algorithm, frames and limits are
+    /// ignored, and BorderPicker sees the complete region. Throws
+    /// std::runtime_error if cfg.metric is not ColorMetric::Hsl.
+    [[nodiscard]] Animation fill(const Image& img, const FillConfig& cfg) const;
+
+private:
+    friend ToleranceMap tolerance_map(const Image&, Point, Connectivity);
+
+    unsigned w_ = 0;
+    unsigned h_ = 0;
+    Point    seed_;
+    std::vector<std::uint16_t> levels_;
+};
+
+/// Build the map for `seed` in one pass: a bucket-queue flood over the
+/// 65536 levels that settles pixels in order of joining tolerance. Costs
+/// about one flood_fill and 2 bytes per pixel, plus 4 bytes per pixel of
+/// queue at worst. A seed outside the image gives an empty map. Throws
+/// std::length_error for images too large for 32-bit pixel indices.
+[[nodiscard]] ToleranceMap tolerance_map(
+    const Image& img, Point seed,
+    Connectivity connectivity = Connectivity::Four);
+
+} // namespace triplefill
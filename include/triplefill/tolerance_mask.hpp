@@ -0,0 +1,103 @@
+#pragma once
+
+#include "image.hpp"
+#include "pixel.hpp"
+#include "tolerance.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace triplefill {
+
+class PreparedImage;
+
+namespace detail { class VerdictTable; }
+
+/// Bit-per-pixel verdicts of `color_distance(seed, px, metric) <= tolerance`
+/// over an image, evaluated lazily in 256-pixel row segments the first time
+/// any pixel of a segment is queried.
+///
+/// Segments are evaluated with color_within, whose SIMD kernels agree with
+/// `color_distance` exactly, including at the threshold.
+///
+/// For metrics where it pays (color_metric_memoised: HSL and Lab) and images
+/// of at least memo_min_pixels, verdicts are also memoised per 24-bit RGB
+/// colour, in a 2-bit-per-colour table shared by every live mask with the
+/// same seed colour, tolerance and metric. The table (4 MB) is allocated on
+/// the first colour not yet known and freed with the last mask using it.
+/// Pixels of a colour seen before skip the kernel. A mask whose hit rate
+/// is below 25% after its first 64K pixels stops using it.
+class ToleranceMask {
+public:
+    static constexpr unsigned segment_shift = 8;
+    static constexpr unsigned segment_size  = 1u << segment_shift;
+
+    /// Smallest image that uses the colour memo: one whose pixels take as
+    /// much memory as the table.
+    static constexpr std::size_t memo_min_pixels = std::size_t{1} << 20;
+
+    /// `img` must outlive the mask.
+    ToleranceMask(const Image& img, const RGBA& seed, double tolerance,
+                  ColorMetric metric = ColorMetric::Hsl);
+
+    /// HSL verdicts over `img.image()`, read from its precomputed planes
+    /// with PreparedImage::within; the colour memo is not used. `img` must
+    /// outlive the mask.
+    ToleranceMask(const PreparedImage& img, const RGBA& seed,
+                  double tolerance);
+
+    [[nodiscard]] bool test(unsigned x, unsigned y) {
+        const std::size_t seg = static_cast<std::size_t>(y) * segs_per_row_ +
+                                (x >> segment_shift);
+        if (!ready_[seg]) evaluate_segment(seg);
+        const unsigned bit = x & (segment_size - 1);
+        return (bits_[seg * words_per_segment + (bit >> 6)] >> (bit & 63)) & 1u;
+    }
+
+    /// Evaluate every segment up front.
+    void evaluate_all();
+
+    /// Pixels evaluated so far; counted only when telemetry_enabled.
+    [[nodiscard]] std::size_t evaluated_pixels() const noexcept {
+        return evaluated_;
+    }
+
+    /// Pixels looked up in the colour memo table, and those it answered.
+    /// Always counted, since they decide whether the table is used.
+    [[nodiscard]] std::size_t memo_lookups() const noexcept { return lookups_; }
+    [[nodiscard]] std::size_t memo_hits()    const noexcept { return hits_; }
+
+    /// Colour memo tables allocated in the process.
+    [[nodiscard]] static std::size_t memo_tables() noexcept;
+
+    /// color_within_kernel().
+    [[nodiscard]] static const char* kernel_name() noexcept;
+
+private:
+    static constexpr std::size_t words_per_segment = segment_size / 64;
+    static constexpr std::size_t memo_warmup = std::size_t{1} << 16;
+
+    void evaluate_segment(std::size_t seg);
+    void evaluate_run(const RGBA* px, std::size_t n, std::uint64_t* out);
+    void evaluate_kernel(const RGBA* px, std::size_t n,
+                         std::uint64_t* out) const;
+
+    const Image* img_;
+    const PreparedImage* prepared_ = nullptr;
+    RGBA         seed_;
+    double       tolerance_;
+    ColorMetric  metric_;
+    std::size_t  segs_per_row_;
+    // Updated from Parallel's workers through std::atomic_ref
+    std::size_t  evaluated_   = 0;
+    std::size_t  lookups_     = 0;
+    std::size_t  hits_        = 0;
+    std::uint8_t bypass_memo_ = 0;
+    std::vector<std::uint64_t> bits_;
+    std::vector<std::uint8_t>  ready_;
+    std::shared_ptr<detail::VerdictTable> verdicts_;
+};
+
+} // namespace triplefill
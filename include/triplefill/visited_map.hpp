@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace triplefill {
+
+/// One bit per pixel visited map with a one-pixel sentinel border.
+///
+/// Coordinates in [-1, w] x [-1, h] are addressable; the border cells read as
+/// visited so the fill engine can test all four neighbours of any in-image
+/// pixel without bounds checks. `filled()` is the bounds-checked query for
+/// callers (such as BorderPicker) that look further than one pixel out and
+/// need the border to read as *not* filled.
+class VisitedMap {
+public:
+    VisitedMap() = default;
+    VisitedMap(unsigned w, unsigned h);
+
+    [[nodiscard]] unsigned width()  const noexcept { return w_; }
+    [[nodiscard]] unsigned height() const noexcept { return h_; }
+
+    /// Padded linear index; neighbours are at +-1 and +-stride().
+    [[nodiscard]] std::size_t index(int x, int y) const noexcept {
+        return static_cast<std::size_t>(y + 1) * stride_ +
+               static_cast<std::size_t>(x + 1);
+    }
+    [[nodiscard]] std::size_t stride() const noexcept { return stride_; }
+
+    [[nodiscard]] bool test(std::size_t i) const noexcept {
+        return (bits_[i >> 6] >> (i & 63)) & 1u;
+    }
+    void set(std::size_t i) noexcept {
+        bits_[i >> 6] |= std::uint64_t{1} << (i & 63);
+    }
+
+    [[nodiscard]] bool test(int x, int y) const noexcept {
+        return test(index(x, y));
+    }
+    void set(int x, int y) noexcept { set(index(x, y)); }
+
+    /// Clear every in-image pixel, keeping the sentinel border.
+    void reset() noexcept;
+
+    /// Mark pixels [xl, xr] of row y.
+    void set_run(int y, int xl, int xr) noexcept;
+
+    /// True only for in-image pixels that have been marked.
+    [[nodiscard]] bool filled(int x, int y) const noexcept {
+        if (x < 0 || y < 0 ||
+            static_cast<unsigned>(x) >= w_ || static_cast<unsigned>(y) >= h_)
+            return false;
+        return test(x, y);
+    }
+
+    /// Heap footprint of the bit array.
+    [[nodiscard]] std::size_t bytes() const noexcept {
+        return bits_.size() * sizeof(std::uint64_t);
+    }
+
+private:
+    unsigned    w_ = 0;
+    unsigned    h_ = 0;
+    std::size_t stride_ = 0;
+    std::vector<std::uint64_t> bits_;
+};
+
+} // namespace triplefill
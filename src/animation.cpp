@@ -1,41 +1,269 @@
 #include "triplefill/animation.hpp"
-#include "gif.h"
+#include "triplefill/frame_generator.hpp"
+#include "triplefill/frame_sink.hpp"
 
+#include <algorithm>
 #include <stdexcept>
+#include <unordered_set>
 
 namespace triplefill {
 
+// ---- storage ---------------------------------------------------------------
+
+namespace {
+
+/// Storage offsets where `a` and `b` differ; same size and layout.
+std::vector<std::uint32_t> changed_offsets(const Image& a, const Image& b) {
+    std::vector<std::uint32_t> out;
+    for (unsigned y = 0; y < a.height(); ++y) {
+        for (unsigned x = 0; x < a.width();) {
+            const unsigned n  = a.contiguous_run(x, y);
+            const RGBA*    pa = &a.at(x, y);
+            const RGBA*    pb = &b.at(x, y);
+            const auto     base = static_cast<std::uint32_t>(pa - a.data());
+            for (unsigned i = 0; i < n; ++i)
+                if (pa[i] != pb[i]) out.push_back(base + i);
+            x += n;
+        }
+    }
+    return out;
+}
+
+} // namespace
+
+void Animation::add_frame(Image img) {
+    if (!empty()) {
+        if (img.width() != last_.width() || img.height() != last_.height())
+            throw std::runtime_error("Frame size does not match the animation");
+        if (img.layout() != last_.layout())
+            img = img.converted(last_.layout());
+        const auto changed = changed_offsets(last_, img);
+        add_frame(std::move(img), changed);
+        return;
+    }
+    add_frame(std::move(img), {});
+}
+
+void Animation::add_frame(const Image& img,
+                          std::span<const std::uint32_t> changed) {
+    if (empty()) {
+        start(img);
+        last_ = img;
+        return;
+    }
+    push(img, changed);
+    for (const std::uint32_t o : changed) last_.data()[o] = img.data()[o];
+}
+
+void Animation::add_frame(Image&& img, std::span<const std::uint32_t> changed) {
+    if (empty()) {
+        start(img);
+        last_ = std::move(img);
+        return;
+    }
+    push(img, changed);
+    last_ = std::move(img);
+}
+
+void Animation::start(const Image& img) {
+    deltas_.emplace_back();
+    key_index_.push_back(0);
+    head_ = TileCanvas(img);
+    keyframes_.push_back(head_);
+    since_key_   = 0;
+    delta_bytes_ = 0;
+    tile_bytes_  = head_.tile_count() * TileCanvas::tile_bytes;
+}
+
+void Animation::push(const Image& img, std::span<const std::uint32_t> changed) {
+    if (img.width() != last_.width() || img.height() != last_.height() ||
+        img.layout() != last_.layout())
+        throw std::runtime_error("Frame size does not match the animation");
+
+    // Tiles shared with the latest keyframe are copied on first write
+    const Layout      layout = img.layout();
+    const std::size_t copies = head_.copied_tiles();
+    for (const std::uint32_t o : changed)
+        head_.write(o, layout) = img.data()[o];
+    tile_bytes_ += (head_.copied_tiles() - copies) * TileCanvas::tile_bytes;
+
+    if (since_key_ + changed.size() > img.pixel_count() / 4) {
+        key_index_.push_back(deltas_.size());
+        deltas_.emplace_back();
+        keyframes_.push_back(head_);
+        since_key_ = 0;
+        return;
+    }
+    std::vector<Change> delta;
+    delta.reserve(changed.size());
+    for (const std::uint32_t o : changed) delta.push_back({o, img.data()[o]});
+    deltas_.push_back(std::move(delta));
+    since_key_   += changed.size();
+    delta_bytes_ += changed.size() * sizeof(Change);
+}
+
+bool Animation::thin(bool only_if_smaller) {
+    const std::size_t n = size();
+    if (n < 2) return false;
+    const Layout      layout  = last_.layout();
+    const unsigned    w       = last_.width();
+    const std::size_t tiles_x =
+        (w + TileCanvas::tile_size - 1) >> TileCanvas::tile_shift;
+    const auto tile_of = [&](std::uint32_t o) -> std::size_t {
+        if (layout == Layout::Tiled) return o >> (2 * TileCanvas::tile_shift);
+        return (o / w >> TileCanvas::tile_shift) * tiles_x +
+               (o % w >> TileCanvas::tile_shift);
+    };
+
+    std::vector<std::size_t> kept;
+    for (std::size_t i = 1; i < n; i += 2) kept.push_back(i);
+    if (n % 2) kept.push_back(n - 1);
+
+    // Replay every frame on `run` to choose how each kept frame is stored.
+    // Kept frame i takes the changes of the frames since the previous one
+    // kept: a delta or, when a keyframe lies among them or its tiles are
+    // cheaper than the delta (longer intervals paint tiles densely), a
+    // snapshot of `run`, or of head_ for the latest frame.
+    std::vector<TileCanvas>  keyframes;
+    std::vector<bool>        snapshot(kept.size());
+    std::size_t              delta_bytes = 0;
+    std::vector<std::size_t> stamp(head_.tile_count(), 0);
+    {
+        TileCanvas  run = keyframes_.front();
+        std::size_t k   = 0;
+        std::size_t from = 1;
+        for (std::size_t m = 0; m < kept.size(); ++m) {
+            bool        crossed_key = false;
+            std::size_t changes = 0, touched = 0;
+            for (std::size_t j = from; j <= kept[m]; ++j) {
+                if (k + 1 < key_index_.size() && key_index_[k + 1] == j) {
+                    run         = keyframes_[++k];
+                    crossed_key = true;
+                    continue;
+                }
+                for (const Change& c : deltas_[j]) {
+                    run.write(c.offset, layout) = c.color;
+                    const std::size_t t = tile_of(c.offset);
+                    if (stamp[t] != from) {
+                        stamp[t] = from;
+                        ++touched;
+                    }
+                }
+                changes += deltas_[j].size();
+            }
+            snapshot[m] = m == 0 || crossed_key ||
+                          touched * TileCanvas::tile_bytes <
+                              changes * sizeof(Change);
+            if (snapshot[m])
+                keyframes.push_back(kept[m] + 1 == n ? head_ : run);
+            else
+                delta_bytes += changes * sizeof(Change);
+            from = kept[m] + 1;
+        }
+    }
+    const std::size_t tile_bytes = count_tile_bytes(keyframes);
+    if (only_if_smaller && tile_bytes + delta_bytes >= tile_bytes_ + delta_bytes_)
+        return false;
+
+    // Merge the deltas kept, freeing the old ones as they are consumed
+    std::vector<std::vector<Change>> deltas;
+    std::vector<std::size_t>         key_index;
+    deltas.reserve(kept.size());
+    std::size_t from = 1;
+    for (std::size_t m = 0; m < kept.size(); ++m) {
+        if (snapshot[m]) {
+            key_index.push_back(deltas.size());
+            deltas.emplace_back();
+        } else {
+            std::vector<Change> merged = std::move(deltas_[from]);
+            for (std::size_t j = from + 1; j <= kept[m]; ++j)
+                merged.insert(merged.end(), deltas_[j].begin(),
+                              deltas_[j].end());
+            deltas.push_back(std::move(merged));
+        }
+        for (std::size_t j = from; j <= kept[m]; ++j) deltas_[j] = {};
+        from = kept[m] + 1;
+    }
+
+    deltas_      = std::move(deltas);
+    key_index_   = std::move(key_index);
+    keyframes_   = std::move(keyframes);
+    since_key_   = 0;
+    for (std::size_t i = key_index_.back() + 1; i < deltas_.size(); ++i)
+        since_key_ += deltas_[i].size();
+    delta_bytes_  = delta_bytes;
+    tile_bytes_   = tile_bytes;
+    cursor_       = Image();
+    cursor_valid_ = false;
+    return true;
+}
+
+const Image& Animation::frame(std::size_t i) const {
+    if (i >= size())
+        throw std::out_of_range("Animation frame index out of range");
+    if (i + 1 == size()) return last_;
+
+    // Nearest keyframe at or before i
+    const auto k = static_cast<std::size_t>(
+        std::upper_bound(key_index_.begin(), key_index_.end(), i) -
+        key_index_.begin() - 1);
+    const std::size_t key = key_index_[k];
+    if (!cursor_valid_ || cursor_index_ < key || cursor_index_ > i) {
+        if (cursor_.width() != last_.width() ||
+            cursor_.height() != last_.height() ||
+            cursor_.layout() != last_.layout())
+            cursor_ = Image(last_.width(), last_.height(), last_.layout());
+        keyframes_[k].copy_to(cursor_);
+        cursor_index_ = key;
+        cursor_valid_ = true;
+    }
+    while (cursor_index_ < i) {
+        ++cursor_index_;
+        for (const Change& c : deltas_[cursor_index_])
+            cursor_.data()[c.offset] = c.color;
+    }
+    return cursor_;
+}
+
+std::size_t Animation::count_tile_bytes(
+    const std::vector<TileCanvas>& keyframes) const {
+    std::unordered_set<const void*> tiles;
+    const auto add = [&](const void* t) { tiles.insert(t); };
+    for (const TileCanvas& k : keyframes) k.for_each_tile(add);
+    head_.for_each_tile(add);
+    return tiles.size() * TileCanvas::tile_bytes;
+}
+
+std::size_t Animation::bytes() const noexcept {
+    std::size_t n = tile_bytes_ + delta_bytes_;
+    n += last_.pixel_count() * sizeof(RGBA);
+    if (cursor_valid_) n += cursor_.pixel_count() * sizeof(RGBA);
+    return n;
+}
+
+// ---- output ----------------------------------------------------------------
+
 void Animation::write_last_png(const std::filesystem::path& path) const {
-    if (frames_.empty())
+    if (empty())
         throw std::runtime_error("Animation has no frames");
-    save_png(path, frames_.back());
+    save_png(path, last_);
 }
 
 void Animation::write_gif(const std::filesystem::path& path,
                           unsigned delay_cs) const {
-    if (frames_.empty())
+    if (empty())
         throw std::runtime_error("Animation has no frames");
 
-    const unsigned w = frames_[0].width();
-    const unsigned h = frames_[0].height();
-
-    GifWriter gw;
-    if (!gif_begin(&gw, path.string().c_str(),
-                   static_cast<int>(w), static_cast<int>(h),
-                   static_cast<uint16_t>(delay_cs)))
-        throw std::runtime_error("Cannot open GIF file: " + path.string());
-
-    for (const auto& frame : frames_) {
-        if (!gif_write_frame(&gw,
-                             reinterpret_cast<const uint8_t*>(frame.data()),
-                             static_cast<int>(w), static_cast<int>(h),
-                             static_cast<uint16_t>(delay_cs))) {
-            gif_end(&gw);
-            throw std::runtime_error("Failed writing GIF frame");
-        }
-    }
+    GifSink gif(path, delay_cs);
+    for (std::size_t i = 0; i < size(); ++i) gif.frame(frame(i), {});
+    gif.close();
+}
 
-    gif_end(&gw);
+void write_gif(const std::filesystem::path& path, FrameGenerator frames,
+               unsigned delay_cs) {
+    GifSink gif(path, delay_cs);
+    for (const Image& frame : frames) gif.frame(frame, {});
+    gif.close();
 }
 
 } // namespace triplefill
@@ -1,13 +1,22 @@
 #include "triplefill/fill.hpp"
+#include "triplefill/frame_sink.hpp"
+#include "fill_internal.hpp"
+#include "fill_kernel.hpp"
+#include "telemetry.hpp"
 #include "triplefill/color_picker.hpp"
 #include "triplefill/pickers/border.hpp"
 #include "triplefill/pickers/quarter.hpp"
 #include "triplefill/pickers/solid.hpp"
 #include "triplefill/pickers/stripe.hpp"
+#include "triplefill/tile_canvas.hpp"
 #include "triplefill/tolerance.hpp"
+#include "triplefill/tolerance_mask.hpp"
+#include "triplefill/visited_map.hpp"
 
-#include <deque>
-#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
 
 namespace triplefill {
 
@@ -37,147 +46,247 @@ ColorPickerFn make_picker(const PickerConfig& cfg) {
 }
 
 ColorPickerFn make_border_picker(const BorderPicker& bp,
-                                 const std::vector<std::uint8_t>& visited,
-                                 unsigned img_w, unsigned img_h) {
-    return [&bp, &visited, img_w, img_h](Point pt, const RGBA& orig) {
-        return pick_border(bp, visited, img_w, img_h, pt, orig);
+                                 const VisitedMap& visited) {
+    return [&bp, &visited](Point pt, const RGBA& orig) {
+        return pick_border(bp, visited, pt, orig);
     };
 }
 
 // ---- flood fill ------------------------------------------------------------
 
-Animation flood_fill(const Image& img, const FillConfig& cfg) {
+namespace detail {
+
+bool seed_in_bounds(const Image& img, Point seed) {
+    return seed.x >= 0 && seed.y >= 0 &&
+           static_cast<unsigned>(seed.x) < img.width() &&
+           static_cast<unsigned>(seed.y) < img.height();
+}
+
+void check_frontier_range(unsigned w, unsigned h) {
+    // Frontier entries are 32-bit padded indices.
+    if ((static_cast<std::size_t>(w) + 2) * (static_cast<std::size_t>(h) + 2) >
+        std::numeric_limits<std::uint32_t>::max())
+        throw std::length_error("Image too large for a 32-bit frontier");
+}
+
+std::size_t animation_floor_bytes(unsigned w, unsigned h) {
+    const std::size_t tiles =
+        ((static_cast<std::size_t>(w) + TileCanvas::tile_size - 1) >>
+         TileCanvas::tile_shift) *
+        ((static_cast<std::size_t>(h) + TileCanvas::tile_size - 1) >>
+         TileCanvas::tile_shift);
+    return static_cast<std::size_t>(w) * h * sizeof(RGBA) +
+           2 * tiles * TileCanvas::tile_bytes;
+}
+
+std::size_t animation_budget(unsigned w, unsigned h, const FillConfig& cfg) {
+    if (!cfg.max_animation_bytes) return 0;
+    return std::max(*cfg.max_animation_bytes, animation_floor_bytes(w, h));
+}
+
+ColorPickerFn build_picker(const PickerConfig& cfg, const VisitedMap& visited,
+                           unsigned w, unsigned h) {
+    return visit_picker(cfg, visited, w, h,
+                        [](auto pick) -> ColorPickerFn { return pick; });
+}
+
+FillStats fill_into(const Image& img, const FillConfig& cfg,
+                    VisitedMap& visited, Frontier& frontier,
+                    ToleranceMask& in_tolerance, bool keep_region,
+                    FrameSink& sink) {
     const unsigned w = img.width();
     const unsigned h = img.height();
 
-    Image canvas = img; // mutable copy
-    Animation anim;
+    FillTelemetry tel;
+    [[maybe_unused]] double setup_seconds = 0;
+    Image canvas;
+    {
+        TRIPLEFILL_TIME_PHASE(setup_seconds);
+        canvas = img; // mutable copy
+        frontier.clear();
+    }
+    std::optional<std::vector<std::uint32_t>> changes;
+    std::size_t frames = 0;
+    std::size_t filled = 0;
+    StopReason  stop   = StopReason::Complete;
+    [[maybe_unused]] const std::size_t evaluated_before =
+        in_tolerance.evaluated_pixels();
+    [[maybe_unused]] const std::size_t memo_hits_before =
+        in_tolerance.memo_hits();
 
-    if (w == 0 || h == 0) return anim;
-    if (cfg.seed.x < 0 || cfg.seed.y < 0 ||
-        static_cast<unsigned>(cfg.seed.x) >= w ||
-        static_cast<unsigned>(cfg.seed.y) >= h)
-        return anim;
+    if (cfg.algorithm == Algorithm::Parallel) {
+        const bool is_border = std::holds_alternative<BorderPicker>(cfg.picker);
+        const auto r = fill_parallel(canvas, in_tolerance, cfg,
+                                     build_picker(cfg.picker, visited, w, h),
+                                     visited, is_border || keep_region);
+        filled = r.filled;
+        stop   = r.stop;
+        tel    = r.telemetry;
+        if (cfg.on_progress)
+            cfg.on_progress(filled, 0);
+    } else {
+        check_frontier_range(w, h);
 
-    const auto npx = static_cast<std::size_t>(w) * h;
-    std::vector<std::uint8_t> visited(npx, 0);
+        // Resolve connectivity, picker and traversal once; the kernel is
+        // instantiated per combination.
+        const auto r =
+            cfg.connectivity == Connectivity::Eight
+                ? run_walk<Connectivity::Eight>(canvas, sink, cfg, visited,
+                                                frontier, in_tolerance)
+                : run_walk<Connectivity::Four>(canvas, sink, cfg, visited,
+                                               frontier, in_tolerance);
+        filled  = r.filled;
+        frames  = r.captured;
+        stop    = r.stop;
+        tel     = r.telemetry;
+        changes = std::move(r.changes);
+    }
 
-    const RGBA seed_color = img.at(static_cast<unsigned>(cfg.seed.x),
-                                   static_cast<unsigned>(cfg.seed.y));
+    // Always send the final frame
+    if (changes)
+        sink.final_frame(std::move(canvas),
+                         std::span<const std::uint32_t>(*changes));
+    else
+        sink.final_frame(std::move(canvas), std::nullopt);
+    ++frames;
 
-    // Construct picker — special-case BorderPicker
-    ColorPickerFn picker;
-    const bool is_border = std::holds_alternative<BorderPicker>(cfg.picker);
-    if (is_border) {
-        const auto& bp = std::get<BorderPicker>(cfg.picker);
-        picker = make_border_picker(bp, visited, w, h);
-    } else {
-        PickerConfig adjusted = cfg.picker;
-        // Auto-set QuarterPicker center if left at origin
-        if (auto* qp = std::get_if<QuarterPicker>(&adjusted);
-            qp && qp->center == Point{0, 0}) {
-            qp->center = Point{static_cast<int>(w / 2),
-                               static_cast<int>(h / 2)};
-        }
-        picker = make_picker(adjusted);
+    // The frames sent since the last check may pass the budget. Thinning
+    // whenever it helps, then regardless, ends within it: a single frame
+    // is below the floor.
+    if (const std::size_t budget = animation_budget(w, h, cfg)) {
+        while (sink.bytes() > budget &&
+               (sink.thin(true) || sink.thin(false)))
+            frames = frames / 2 + frames % 2;
     }
 
-    // Ordering structure: deque for BFS (FIFO), vector for DFS (LIFO)
-    std::deque<Point>  bfs_queue;
-    std::vector<Point> dfs_stack;
+    TRIPLEFILL_COUNT(tel.setup_seconds, setup_seconds);
+    TRIPLEFILL_COUNT(tel.tolerance_evaluations,
+                     in_tolerance.evaluated_pixels() - evaluated_before);
+    TRIPLEFILL_COUNT(tel.memo_hits,
+                     in_tolerance.memo_hits() - memo_hits_before);
+    return {filled, frames, frontier.peak(), stop, tel};
+}
 
-    auto push = [&](Point p) {
-        if (cfg.algorithm == Algorithm::BFS)
-            bfs_queue.push_back(p);
-        else
-            dfs_stack.push_back(p);
-    };
-    auto pop = [&]() -> Point {
-        Point p;
-        if (cfg.algorithm == Algorithm::BFS) {
-            p = bfs_queue.front();
-            bfs_queue.pop_front();
-        } else {
-            p = dfs_stack.back();
-            dfs_stack.pop_back();
+Animation fill_into(const Image& img, const FillConfig& cfg,
+                    VisitedMap& visited, Frontier& frontier,
+                    ToleranceMask& in_tolerance, bool keep_region) {
+    Animation     anim;
+    AnimationSink sink(anim);
+    anim.set_stats(fill_into(img, cfg, visited, frontier, in_tolerance,
+                             keep_region, sink));
+    return anim;
+}
+
+bool order_independent(const FillConfig& cfg) {
+    if (cfg.frame_freq > 0) return false;
+    if (cfg.cancel || cfg.deadline || cfg.max_pixels) return false;
+    return !std::holds_alternative<BorderPicker>(cfg.picker) ||
+           cfg.algorithm == Algorithm::Parallel;
+}
+
+Animation paint_region(const Image& img, const FillConfig& cfg,
+                       const VisitedMap& region, std::size_t count) {
+    const unsigned w = img.width();
+    const unsigned h = img.height();
+
+    Image canvas = img;
+    FillTelemetry tel;
+    visit_picker(cfg.picker, region, w, h, [&](auto pick) {
+        TRIPLEFILL_TIME_PHASE(tel.paint_seconds);
+        for (unsigned y = 0; y < h; ++y) {
+            for (unsigned x = 0; x < w; ++x) {
+                const Point p{static_cast<int>(x), static_cast<int>(y)};
+                if (!region.test(p.x, p.y)) continue;
+                RGBA& px = canvas.at(x, y);
+                px = pick(p, px);
+            }
         }
-        return p;
-    };
-    auto empty = [&]() -> bool {
-        return cfg.algorithm == Algorithm::BFS
-                   ? bfs_queue.empty()
-                   : dfs_stack.empty();
-    };
-    auto queued = [&]() -> std::size_t {
-        return cfg.algorithm == Algorithm::BFS
-                   ? bfs_queue.size()
-                   : dfs_stack.size();
-    };
+    });
 
-    // Mark visited on push
-    auto mark = [&](int x, int y) {
-        visited[static_cast<std::size_t>(y) * w + x] = 1;
-    };
-    auto is_visited = [&](int x, int y) -> bool {
-        return visited[static_cast<std::size_t>(y) * w + x] != 0;
-    };
+    Animation anim;
+    anim.add_frame(std::move(canvas));
+    TRIPLEFILL_COUNT(tel.picker_calls, count);
+    anim.set_stats({count, anim.size(), 0, StopReason::Complete, tel});
+    if (cfg.on_progress)
+        cfg.on_progress(count, 0);
+    return anim;
+}
 
-    // Seed
-    mark(cfg.seed.x, cfg.seed.y);
-    push(cfg.seed);
+} // namespace detail
 
-    std::size_t filled = 0;
-    const int freq = cfg.frame_freq;
+Animation flood_fill(const Image& img, const FillConfig& cfg) {
+    if (!detail::seed_in_bounds(img, cfg.seed))
+        return {};
 
-    // Neighbour offsets: North, East, South, West
-    static constexpr int dx[] = { 0, 1, 0, -1};
-    static constexpr int dy[] = {-1, 0, 1,  0};
+    VisitedMap visited(img.width(), img.height());
+    detail::Frontier frontier(img.width(), img.height());
 
-    while (!empty()) {
-        const Point cur = pop();
+    // Tolerance verdicts are evaluated lazily, a row segment at a time, by
+    // the SIMD kernels rather than per neighbour test.
+    const RGBA seed_color = img.at(static_cast<unsigned>(cfg.seed.x),
+                                   static_cast<unsigned>(cfg.seed.y));
+    ToleranceMask in_tolerance(img, seed_color, cfg.tolerance, cfg.metric);
 
-        // Colour on pop
-        const RGBA orig = canvas.at(static_cast<unsigned>(cur.x),
-                                    static_cast<unsigned>(cur.y));
-        canvas.at(static_cast<unsigned>(cur.x),
-                  static_cast<unsigned>(cur.y)) = picker(cur, orig);
+    return detail::fill_into(img, cfg, visited, frontier, in_tolerance, false);
+}
 
-        ++filled;
+std::size_t estimate_fill_memory(unsigned w, unsigned h, const FillConfig& cfg) {
+    const std::size_t pixels = static_cast<std::size_t>(w) * h;
+    const std::size_t image  = pixels * sizeof(RGBA);
 
-        // Frame capture: every freq-th pixel, starting at the freq-th
-        if (freq > 0 && (filled % static_cast<std::size_t>(freq)) == 0) {
-            if (!cfg.max_frames || anim.size() < *cfg.max_frames)
-                anim.add_frame(canvas);
-        }
+    // Working canvas, visited map (a bit per padded pixel), frontier
+    const std::size_t padded =
+        (static_cast<std::size_t>(w) + 2) * (static_cast<std::size_t>(h) + 2);
+    std::size_t frontier = 1024;
+    while (frontier < 2 * (static_cast<std::size_t>(w) + h)) frontier <<= 1;
+    std::size_t n = image + (padded + 63) / 64 * sizeof(std::uint64_t) +
+                    frontier * sizeof(std::uint32_t);
 
-        if (cfg.on_progress)
-            cfg.on_progress(filled, queued());
-
-        // Push in-tolerance unvisited neighbours
-        for (int d = 0; d < 4; ++d) {
-            const int nx = cur.x + dx[d];
-            const int ny = cur.y + dy[d];
-            if (nx < 0 || ny < 0 ||
-                static_cast<unsigned>(nx) >= w ||
-                static_cast<unsigned>(ny) >= h)
-                continue;
-            if (is_visited(nx, ny)) continue;
-
-            const RGBA& nc = img.at(static_cast<unsigned>(nx),
-                                    static_cast<unsigned>(ny));
-            if (color_distance(seed_color, nc) <= cfg.tolerance) {
-                mark(nx, ny);
-                push({nx, ny});
-            }
-        }
-    }
+    // Tolerance mask: a bit and a flag byte per segment pixel / segment,
+    // and the shared 2-bit-per-colour memo
+    const std::size_t segments =
+        (static_cast<std::size_t>(w) + ToleranceMask::segment_size - 1) /
+        ToleranceMask::segment_size * h;
+    n += segments * (ToleranceMask::segment_size / 8 + 1);
+    if (color_metric_memoised(cfg.metric) &&
+        pixels >= ToleranceMask::memo_min_pixels)
+        n += (std::size_t{1} << 24) / 4;
 
-    // Always add final frame
-    anim.add_frame(canvas);
+    if (cfg.algorithm == Algorithm::Parallel)
+        return n + pixels * sizeof(std::uint32_t); // labels; final frame only
 
-    anim.set_stats({filled, anim.size()});
+    // The Animation: the latest frame and a tiled copy, an 8-byte change
+    // per painted pixel, and keyframes every quarter image of changes,
+    // each at worst every tile. The fill tracks up to a frame's offsets.
+    const std::size_t tiles = (detail::animation_floor_bytes(w, h) - image) / 2;
+    if (cfg.frame_freq <= 0 || (cfg.max_frames && *cfg.max_frames == 0))
+        return n; // the canvas becomes the only frame
+    const auto freq = static_cast<std::size_t>(cfg.frame_freq);
+    std::size_t painted = pixels;
+    if (cfg.max_frames && *cfg.max_frames < pixels / freq)
+        painted = *cfg.max_frames * freq;
+    std::size_t anim = image + tiles + painted * 8 + 4 * tiles;
+    n += std::min(freq, pixels) * sizeof(std::uint32_t);
 
-    return anim;
+    // Within the budget, raised to the floor, plus the frames added before
+    // the next check
+    if (const std::size_t budget = detail::animation_budget(w, h, cfg))
+        anim = std::min(anim, budget + 2 * std::min(freq, pixels) * 8);
+    return n + anim;
+}
+
+FillStats flood_fill(const Image& img, const FillConfig& cfg, FrameSink& sink) {
+    if (!detail::seed_in_bounds(img, cfg.seed))
+        return {};
+
+    VisitedMap visited(img.width(), img.height());
+    detail::Frontier frontier(img.width(), img.height());
+    const RGBA seed_color = img.at(static_cast<unsigned>(cfg.seed.x),
+                                   static_cast<unsigned>(cfg.seed.y));
+    ToleranceMask in_tolerance(img, seed_color, cfg.tolerance, cfg.metric);
+
+    return detail::fill_into(img, cfg, visited, frontier, in_tolerance, false,
+                             sink);
 }
 
 } // namespace triplefill
@@ -0,0 +1,132 @@
+#include "triplefill/fill_cache.hpp"
+#include "fill_internal.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <utility>
+
+namespace triplefill {
+
+namespace {
+
+static_assert(sizeof(RGBA) == 4);
+
+constexpr std::uint64_t mul = 0x9E3779B97F4A7C15ull;
+
+/// splitmix64's finaliser: every input bit reaches every output bit.
+std::uint64_t avalanche(std::uint64_t z) noexcept {
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+    return z ^ (z >> 31);
+}
+
+/// Hash of the pixels on a 16x16 grid spanning the image (every pixel of a
+/// smaller one). Stored with each entry, so a digest collision between two
+/// images is caught before a wrong region is painted.
+std::uint64_t sample_digest(const Image& img) {
+    constexpr unsigned n = 16;
+    std::uint64_t h = 0;
+    const unsigned rows = std::min(n, img.height());
+    const unsigned cols = std::min(n, img.width());
+    for (unsigned j = 0; j < rows; ++j) {
+        const unsigned y =
+            rows > 1 ? j * (img.height() - 1) / (rows - 1) : 0;
+        for (unsigned i = 0; i < cols; ++i) {
+            const unsigned x =
+                cols > 1 ? i * (img.width() - 1) / (cols - 1) : 0;
+            std::uint32_t v;
+            std::memcpy(&v, &img.at(x, y), sizeof v);
+            h = (h ^ v) * mul;
+        }
+    }
+    return avalanche(h);
+}
+
+} // namespace
+
+std::uint64_t image_digest(const Image& img) {
+    // Four independent multiply chains, picked by x, so the loop is not one
+    // long dependency chain and the digest does not depend on how the rows
+    // are split into contiguous runs.
+    std::uint64_t lane[4] = {1, 2, 3, 4};
+    for (unsigned y = 0; y < img.height(); ++y) {
+        for (unsigned x = 0; x < img.width();) {
+            const unsigned n  = img.contiguous_run(x, y);
+            const RGBA*    px = &img.at(x, y);
+            for (unsigned i = 0; i < n; ++i) {
+                std::uint32_t v;
+                std::memcpy(&v, px + i, sizeof v);
+                std::uint64_t& l = lane[(x + i) & 3];
+                l = (l ^ v) * mul;
+            }
+            x += n;
+        }
+    }
+    std::uint64_t h = avalanche(
+        (static_cast<std::uint64_t>(img.width()) << 32) | img.height());
+    for (const std::uint64_t l : lane) h = avalanche(h ^ l);
+    return h;
+}
+
+Animation FillCache::fill(const Image& img, std::uint64_t digest,
+                          const FillConfig& cfg) {
+    if (!detail::seed_in_bounds(img, cfg.seed))
+        return {};
+
+    const RGBA seed_color = img.at(static_cast<unsigned>(cfg.seed.x),
+                                   static_cast<unsigned>(cfg.seed.y));
+    const std::uint64_t sample = sample_digest(img);
+    Entry* cached = find(img, digest, sample, seed_color, cfg);
+    if (cached && detail::order_independent(cfg)) {
+        ++hits_;
+        return detail::paint_region(img, cfg, cached->region, cached->count);
+    }
+
+    ++misses_;
+    VisitedMap       visited(img.width(), img.height());
+    detail::Frontier frontier(img.width(), img.height());
+    ToleranceMask    in_tolerance(img, seed_color, cfg.tolerance,
+                                  cfg.metric);
+    Animation anim = detail::fill_into(img, cfg, visited, frontier,
+                                       in_tolerance, true);
+
+    // The region does not depend on the algorithm or picker, so any
+    // complete fill can answer later hits.
+    if (!cached && !anim.stats().truncated())
+        insert({digest, sample, seed_color, cfg.tolerance, cfg.connectivity,
+                cfg.metric, std::move(visited), anim.stats().filled_pixels});
+    return anim;
+}
+
+FillCache::Entry* FillCache::find(const Image& img, std::uint64_t digest,
+                                  std::uint64_t sample,
+                                  const RGBA& seed_color,
+                                  const FillConfig& cfg) {
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->digest == digest && it->sample == sample &&
+            it->region.width() == img.width() &&
+            it->region.height() == img.height() &&
+            it->seed_color == seed_color &&
+            it->tolerance == cfg.tolerance &&
+            it->connectivity == cfg.connectivity &&
+            it->metric == cfg.metric &&
+            it->region.test(cfg.seed.x, cfg.seed.y)) {
+            entries_.splice(entries_.begin(), entries_, it);
+            return &entries_.front();
+        }
+    }
+    return nullptr;
+}
+
+void FillCache::insert(Entry entry) {
+    const std::size_t need = entry.region.bytes();
+    if (need > max_bytes_) return;
+    while (bytes_ + need > max_bytes_) {
+        bytes_ -= entries_.back().region.bytes();
+        entries_.pop_back();
+    }
+    bytes_ += need;
+    entries_.push_front(std::move(entry));
+}
+
+} // namespace triplefill
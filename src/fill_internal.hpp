@@ -0,0 +1,203 @@
+#pragma once
+
+// Building blocks shared between the fill engine translation units.
+// Not part of the public API.
+
+#include "triplefill/animation.hpp"
+#include "triplefill/color_picker.hpp"
+#include "triplefill/fill.hpp"
+#include "triplefill/frame_sink.hpp"
+#include "triplefill/image.hpp"
+#include "triplefill/point.hpp"
+#include "triplefill/tolerance_mask.hpp"
+#include "triplefill/visited_map.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <thread>
+#include <vector>
+
+namespace triplefill::detail {
+
+/// Worker count for `requested` threads (0 = one per hardware thread).
+inline unsigned resolve_threads(unsigned requested) {
+    if (requested != 0) return requested;
+    return std::max(1u, std::thread::hardware_concurrency());
+}
+
+/// Run fn() once on each of `workers` threads; the calling thread is one of
+/// them. The first exception thrown by any worker is rethrown after all
+/// workers have finished.
+template <class Fn>
+void run_workers(std::size_t workers, Fn&& fn) {
+    if (workers <= 1) {
+        fn();
+        return;
+    }
+
+    std::exception_ptr error;
+    std::mutex         error_mu;
+    auto guarded = [&] {
+        try {
+            fn();
+        } catch (...) {
+            std::lock_guard lock(error_mu);
+            if (!error) error = std::current_exception();
+        }
+    };
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers - 1);
+    for (std::size_t t = 1; t < workers; ++t) pool.emplace_back(guarded);
+    guarded();
+    for (auto& t : pool) t.join();
+    if (error) std::rethrow_exception(error);
+}
+
+/// Run fn(i) for i in [0, n) on up to `threads` threads. Tasks are handed
+/// out dynamically from a shared counter.
+template <class Fn>
+void parallel_for(std::size_t n, unsigned threads, Fn&& fn) {
+    std::atomic<std::size_t> next{0};
+    run_workers(std::min<std::size_t>(threads, n), [&] {
+        for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;)
+            fn(i);
+    });
+}
+
+/// Ring buffer of 32-bit pixel indices used as a FIFO (BFS) or a stack
+/// (DFS, Scanline seeds). The capacity is a power of two sized from the image
+/// perimeter, which covers the frontier of ordinary regions, so a fill makes
+/// no allocations; only pathological (comb-like) regions force a doubling.
+/// Storage is left uninitialised.
+class Frontier {
+public:
+    Frontier() = default;
+    Frontier(unsigned w, unsigned h) {
+        std::size_t cap = 1024;
+        while (cap < 2 * (static_cast<std::size_t>(w) + h)) cap <<= 1;
+        buf_ = std::make_unique_for_overwrite<std::uint32_t[]>(cap);
+        mask_ = cap - 1;
+    }
+
+    void clear() noexcept { head_ = size_ = peak_ = 0; }
+
+    [[nodiscard]] bool        empty() const noexcept { return size_ == 0; }
+    [[nodiscard]] std::size_t size()  const noexcept { return size_; }
+    /// Largest size reached since the last clear().
+    [[nodiscard]] std::size_t peak()  const noexcept { return peak_; }
+    [[nodiscard]] std::size_t capacity() const noexcept {
+        return buf_ ? mask_ + 1 : 0;
+    }
+
+    void push(std::uint32_t v) {
+        if (size_ == capacity()) grow();
+        buf_[(head_ + size_) & mask_] = v;
+        if (++size_ > peak_) peak_ = size_;
+    }
+    std::uint32_t pop_front() noexcept {
+        const std::uint32_t v = buf_[head_];
+        head_ = (head_ + 1) & mask_;
+        --size_;
+        return v;
+    }
+    std::uint32_t pop_back() noexcept {
+        --size_;
+        return buf_[(head_ + size_) & mask_];
+    }
+
+private:
+    void grow() {
+        const std::size_t cap = std::max<std::size_t>(2 * capacity(), 1024);
+        auto next = std::make_unique_for_overwrite<std::uint32_t[]>(cap);
+        for (std::size_t i = 0; i < size_; ++i)
+            next[i] = buf_[(head_ + i) & mask_];
+        buf_  = std::move(next);
+        mask_ = cap - 1;
+        head_ = 0;
+    }
+
+    std::unique_ptr<std::uint32_t[]> buf_;
+    std::size_t mask_ = 0;
+    std::size_t head_ = 0;
+    std::size_t size_ = 0;
+    std::size_t peak_ = 0;
+};
+
+bool seed_in_bounds(const Image& img, Point seed);
+
+/// Cancelled or past the deadline; nullopt while the fill may continue.
+inline std::optional<StopReason> interrupted(const FillConfig& cfg) {
+    if (cfg.cancel.cancelled()) return StopReason::Cancelled;
+    if (cfg.deadline && std::chrono::steady_clock::now() >= *cfg.deadline)
+        return StopReason::Deadline;
+    return std::nullopt;
+}
+
+/// Throws std::length_error when a w x h image's padded indices do not fit
+/// a Frontier entry.
+void check_frontier_range(unsigned w, unsigned h);
+
+/// Bytes an Animation of a w x h fill can always be thinned to: the latest
+/// frame, its tiled copy and a first keyframe sharing no tile with it.
+std::size_t animation_floor_bytes(unsigned w, unsigned h);
+
+/// cfg.max_animation_bytes raised to animation_floor_bytes(w, h), or 0
+/// without a budget.
+std::size_t animation_budget(unsigned w, unsigned h, const FillConfig& cfg);
+
+/// Type-erased form of the kernel's picker for `cfg`: BorderPicker reads
+/// `visited`, and a QuarterPicker centred at the origin is re-centred on
+/// the image. `cfg` must outlive the result.
+ColorPickerFn build_picker(const PickerConfig& cfg, const VisitedMap& visited,
+                           unsigned w, unsigned h);
+
+/// The flood_fill engine over caller-owned scratch. `visited` must be clear
+/// and sized to `img`; `in_tolerance` must be built for the seed's colour
+/// and cfg.tolerance. The seed must be in bounds. `frontier` is cleared
+/// before use. On return from a fill that was not truncated, `visited`
+/// holds exactly the filled region when `keep_region` is set (always true
+/// except for Algorithm::Parallel, which otherwise skips marking it).
+/// Frames go to `sink`; the Animation overload collects them.
+FillStats fill_into(const Image& img, const FillConfig& cfg,
+                    VisitedMap& visited, Frontier& frontier,
+                    ToleranceMask& in_tolerance, bool keep_region,
+                    FrameSink& sink);
+Animation fill_into(const Image& img, const FillConfig& cfg,
+                    VisitedMap& visited, Frontier& frontier,
+                    ToleranceMask& in_tolerance, bool keep_region);
+
+/// True when the result of `cfg` does not depend on traversal order, so it
+/// can be produced from a cached region with paint_region. Limited fills
+/// always traverse.
+bool order_independent(const FillConfig& cfg);
+
+/// Final-frame-only result of applying cfg.picker to an already known
+/// region of `count` pixels, without traversal.
+Animation paint_region(const Image& img, const FillConfig& cfg,
+                       const VisitedMap& region, std::size_t count);
+
+struct ParallelResult {
+    std::size_t filled = 0;
+    StopReason  stop   = StopReason::Complete;
+    FillTelemetry telemetry{};
+};
+
+/// Tiled connected-component fill (Algorithm::Parallel). Paints the
+/// component of cfg.seed onto `canvas` and returns its pixel count. When
+/// `mark_visited` is set the component is also written to `visited` before
+/// painting, so a BorderPicker sees the complete region. A stop (see
+/// FillConfig) is only honoured before painting starts and leaves both
+/// `canvas` and `visited` untouched, with `filled` 0.
+ParallelResult fill_parallel(Image& canvas, ToleranceMask& mask,
+                             const FillConfig& cfg, const ColorPickerFn& picker,
+                             VisitedMap& visited, bool mark_visited);
+
+} // namespace triplefill::detail
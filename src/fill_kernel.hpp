@@ -0,0 +1,567 @@
+#pragma once
+
+// Statically dispatched fill kernel. flood_fill resolves the picker
+// alternative and the algorithm once, at entry; everything below is then
+// instantiated per (traversal, picker) so picker calls inline and the
+// frontier discipline (FIFO / LIFO) is fixed at compile time.
+
+#include "fill_internal.hpp"
+#include "telemetry.hpp"
+#include "triplefill/animation.hpp"
+#include "triplefill/fill.hpp"
+#include "triplefill/frame_sink.hpp"
+#include "triplefill/image.hpp"
+#include "triplefill/pickers/border.hpp"
+#include "triplefill/pickers/quarter.hpp"
+#include "triplefill/pickers/solid.hpp"
+#include "triplefill/pickers/stripe.hpp"
+#include "triplefill/tolerance_mask.hpp"
+#include "triplefill/visited_map.hpp"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <span>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+namespace triplefill::detail {
+
+// ---- pickers ---------------------------------------------------------------
+
+struct SolidPick {
+    RGBA color;
+    RGBA operator()(Point, const RGBA&) const { return color; }
+};
+
+struct StripePick {
+    StripePicker p;
+    RGBA operator()(Point pt, const RGBA& orig) const {
+        return pick_stripe(p, pt, orig);
+    }
+};
+
+/// pick_quarter depends only on the quadrant, so the four luminance-shifted
+/// colours are resolved once instead of per pixel.
+struct QuarterPick {
+    Point center;
+    RGBA  quad[4];
+
+    QuarterPick(const QuarterPicker& p, unsigned w, unsigned h) {
+        QuarterPicker q = p;
+        // Auto-set center if left at origin
+        if (q.center == Point{0, 0})
+            q.center = Point{static_cast<int>(w / 2), static_cast<int>(h / 2)};
+        center = q.center;
+        const int l = center.x - 1, r = center.x;
+        const int t = center.y - 1, b = center.y;
+        quad[0] = pick_quarter(q, {l, t}, RGBA{});
+        quad[1] = pick_quarter(q, {r, t}, RGBA{});
+        quad[2] = pick_quarter(q, {l, b}, RGBA{});
+        quad[3] = pick_quarter(q, {r, b}, RGBA{});
+    }
+
+    RGBA operator()(Point pt, const RGBA&) const {
+        return quad[(pt.x >= center.x ? 1 : 0) + (pt.y >= center.y ? 2 : 0)];
+    }
+};
+
+struct BorderPick {
+    const BorderPicker* bp;
+    const VisitedMap*   visited;
+    RGBA operator()(Point pt, const RGBA& orig) const {
+        return pick_border(*bp, *visited, pt, orig);
+    }
+};
+
+/// Call fn with the concrete picker functor for `cfg`.
+template <class Fn>
+decltype(auto) visit_picker(const PickerConfig& cfg, const VisitedMap& visited,
+                            unsigned w, unsigned h, Fn&& fn) {
+    return std::visit(
+        [&](const auto& p) -> decltype(auto) {
+            using T = std::decay_t<decltype(p)>;
+            if constexpr (std::is_same_v<T, SolidPicker>)
+                return fn(SolidPick{p.color});
+            else if constexpr (std::is_same_v<T, StripePicker>)
+                return fn(StripePick{p});
+            else if constexpr (std::is_same_v<T, QuarterPicker>)
+                return fn(QuarterPick{p, w, h});
+            else
+                return fn(BorderPick{&p, &visited});
+        },
+        cfg);
+}
+
+// ---- painting + frame capture ----------------------------------------------
+
+/// Copies whole frames into a vector (FillSession's steps).
+class VectorOut final : public FrameSink {
+public:
+    explicit VectorOut(std::vector<Image>& frames) : frames_(&frames) {}
+
+    /// Send subsequent frames to `frames`.
+    void reset(std::vector<Image>& frames) noexcept { frames_ = &frames; }
+
+    void frame(const Image& canvas, Changes) override {
+        frames_->push_back(canvas);
+    }
+
+private:
+    std::vector<Image>* frames_;
+};
+
+/// Colours pixels on the canvas and captures a frame on every freq-th
+/// pixel, starting at the freq-th, into the current frame sink. Past
+/// cfg.max_animation_bytes, raised to the floor, the sink is thinned and
+/// freq doubles whenever that frees memory.
+///
+/// For sinks that want them, the storage offsets painted since the last
+/// stored frame are tracked too, so a frame costs O(pixels painted) rather
+/// than O(image). Tracking starts with the first capture's frame period
+/// and is skipped for canvases whose offsets may not fit 32 bits.
+template <class Pick>
+class Painter {
+public:
+    Painter(Image& canvas, FrameSink& out, const FillConfig& cfg, Pick pick)
+        : canvas_(canvas), out_(&out), cfg_(cfg), pick_(pick),
+          freq_(cfg.frame_freq > 0 ? static_cast<std::size_t>(cfg.frame_freq)
+                                   : 0),
+          next_frame_(freq_ ? freq_ : std::numeric_limits<std::size_t>::max()),
+          track_(freq_ && (!cfg.max_frames || *cfg.max_frames > 0) &&
+                 out.wants_changes() && offsets_fit(canvas)),
+          budget_(animation_budget(canvas.width(), canvas.height(), cfg)) {
+        if (track_) changed_.reserve(freq_);
+    }
+
+    void pixel(int x, int y) {
+        RGBA& px = canvas_.at(static_cast<unsigned>(x),
+                              static_cast<unsigned>(y));
+        px = pick_(Point{x, y}, px);
+        if (track_)
+            changed_.push_back(static_cast<std::uint32_t>(&px - canvas_.data()));
+        TRIPLEFILL_COUNT(telemetry_.picker_calls, 1);
+        if (++filled_ == next_frame_) capture();
+    }
+
+    /// Colour [xl, xr] of row y left to right. The run is painted in chunks
+    /// that end on frame boundaries and on storage discontinuities of a tiled
+    /// canvas, so trivial pickers become a plain fill.
+    void run(int y, int xl, int xr) {
+        const auto uy = static_cast<unsigned>(y);
+        int x = xl;
+        while (x <= xr) {
+            const auto ux = static_cast<unsigned>(x);
+            RGBA* px = &canvas_.at(ux, uy);
+            const std::size_t left = static_cast<std::size_t>(xr - x) + 1;
+            const std::size_t contiguous = canvas_.contiguous_run(ux, uy);
+            const std::size_t chunk =
+                std::min({left, next_frame_ - filled_, contiguous});
+            if (track_) {
+                const auto base =
+                    static_cast<std::uint32_t>(px - canvas_.data());
+                for (std::size_t i = 0; i < chunk; ++i)
+                    changed_.push_back(base + static_cast<std::uint32_t>(i));
+            }
+            for (std::size_t i = 0; i < chunk; ++i, ++x)
+                px[i] = pick_(Point{x, y}, px[i]);
+            TRIPLEFILL_COUNT(telemetry_.picker_calls, chunk);
+            filled_ += chunk;
+            if (filled_ == next_frame_) capture();
+        }
+    }
+
+    /// Offsets painted since the last stored frame, or null if untracked.
+    [[nodiscard]] std::vector<std::uint32_t>* changes() noexcept {
+        return track_ ? &changed_ : nullptr;
+    }
+
+    [[nodiscard]] std::size_t filled()   const noexcept { return filled_; }
+    [[nodiscard]] std::size_t captured() const noexcept { return captured_; }
+    [[nodiscard]] const Pick& pick()     const noexcept { return pick_; }
+
+    /// Counters for this fill; the walk adds its neighbour tests here.
+    [[nodiscard]] FillTelemetry&       telemetry()       noexcept { return telemetry_; }
+    [[nodiscard]] const FillTelemetry& telemetry() const noexcept { return telemetry_; }
+
+private:
+    static bool offsets_fit(const Image& canvas) noexcept {
+        // Tiled storage pads the last block row and column
+        return (std::uint64_t{canvas.width()} + Image::tile_size) *
+                   (std::uint64_t{canvas.height()} + Image::tile_size) <=
+               std::numeric_limits<std::uint32_t>::max();
+    }
+
+    void capture() {
+        next_frame_ += freq_;
+        if (!cfg_.max_frames || captured_ < *cfg_.max_frames) {
+            TRIPLEFILL_TIME_PHASE(telemetry_.capture_seconds);
+            if (track_)
+                out_->frame(canvas_, std::span<const std::uint32_t>(changed_));
+            else
+                out_->frame(canvas_, std::nullopt);
+            TRIPLEFILL_COUNT(telemetry_.frame_copy_bytes,
+                             track_ ? changed_.size() * (sizeof(std::uint32_t) + sizeof(RGBA))
+                                    : canvas_.pixel_count() * sizeof(RGBA));
+            changed_.clear();
+            ++captured_;
+            if (budget_ && captured_ % 2 == 0 && captured_ >= retry_at_ &&
+                out_->bytes() > budget_)
+                thin();
+        }
+    }
+
+    /// Halve the frames held and double the capture interval if that frees
+    /// memory; frames so far were at multiples of freq_, those kept at
+    /// multiples of 2 freq_. Otherwise retry once the frames held double,
+    /// as each attempt replays every change.
+    void thin() {
+        if (!out_->thin(true)) {
+            retry_at_ = 2 * captured_;
+            return;
+        }
+        captured_ /= 2;
+        freq_ *= 2;
+        next_frame_ = filled_ + freq_;
+        retry_at_   = 0;
+    }
+
+    Image&              canvas_;
+    FrameSink*          out_;
+    const FillConfig&   cfg_;
+    Pick                pick_;
+    std::size_t         filled_   = 0;
+    std::size_t         captured_ = 0;
+    std::size_t         freq_;
+    std::size_t         next_frame_;
+    bool                track_;
+    std::size_t         budget_;       // see animation_budget(); 0 for none
+    std::size_t         retry_at_ = 0; // captured_ before thinning again
+    std::vector<std::uint32_t> changed_;
+    FillTelemetry       telemetry_;
+};
+
+// ---- neighbourhoods --------------------------------------------------------
+
+/// Neighbour expansion for one connectivity, unrolled at compile time.
+/// expand() calls push(index, x, y) for each neighbour of the pixel at padded
+/// index `cur` in the order documented on flood_fill; `row_reach` is how far
+/// past a run's ends Scanline scans the rows above and below.
+template <Connectivity C>
+struct Neighbours;
+
+template <>
+struct Neighbours<Connectivity::Four> {
+    static constexpr int row_reach = 0;
+
+    template <class Push>
+    static void expand(std::uint32_t cur, int x, int y, std::uint32_t stride,
+                       Push&& push) {
+        push(cur - stride, x,     y - 1); // N
+        push(cur + 1,      x + 1, y);     // E
+        push(cur + stride, x,     y + 1); // S
+        push(cur - 1,      x - 1, y);     // W
+    }
+};
+
+template <>
+struct Neighbours<Connectivity::Eight> {
+    static constexpr int row_reach = 1;
+
+    template <class Push>
+    static void expand(std::uint32_t cur, int x, int y, std::uint32_t stride,
+                       Push&& push) {
+        push(cur - stride,     x,     y - 1); // N
+        push(cur - stride + 1, x + 1, y - 1); // NE
+        push(cur + 1,          x + 1, y);     // E
+        push(cur + stride + 1, x + 1, y + 1); // SE
+        push(cur + stride,     x,     y + 1); // S
+        push(cur + stride - 1, x - 1, y + 1); // SW
+        push(cur - 1,          x - 1, y);     // W
+        push(cur - stride - 1, x - 1, y - 1); // NW
+    }
+};
+
+// ---- traversals ------------------------------------------------------------
+//
+// Frontier entries are padded VisitedMap indices, so neighbours are +-1 and
+// +-stride and the sentinel border replaces bounds checks. Coordinates are
+// recovered once per popped pixel.
+//
+// A walk is resumable: advance(limit) paints until the painter has filled
+// `limit` pixels in total or the region is complete, and returns true once
+// it is complete. flood_fill passes no limit; FillSession steps through.
+//
+// Walks are generic over the painter (Painter<Pick> here) and the tolerance
+// test (ToleranceMask), so the paged file engine can run the same kernels
+// over tiles.
+
+/// BFS (FIFO) or DFS (LIFO). Neighbours are pushed in Neighbours<C> order;
+/// pixels are marked visited on push and coloured on pop.
+template <bool Lifo, Connectivity C, class Paint, class Mask = ToleranceMask>
+class QueueWalk {
+public:
+    QueueWalk(const FillConfig& cfg, VisitedMap& visited, Frontier& frontier,
+              Mask& in_tolerance, Paint& paint)
+        : cfg_(cfg), visited_(visited), frontier_(frontier),
+          in_tolerance_(in_tolerance), paint_(paint),
+          stride_(static_cast<std::uint32_t>(visited.stride())) {
+        const auto seed =
+            static_cast<std::uint32_t>(visited.index(cfg.seed.x, cfg.seed.y));
+        visited_.set(seed);
+        frontier_.push(seed);
+    }
+
+    bool advance(std::size_t limit) {
+        // Locals rather than members, so the compiler can keep them in
+        // registers across the stores into the visited map and frontier.
+        const FillConfig& cfg          = cfg_;
+        VisitedMap&       visited      = visited_;
+        Frontier&         frontier     = frontier_;
+        Mask&             in_tolerance = in_tolerance_;
+        Paint&            paint        = paint_;
+        const std::uint32_t stride     = stride_;
+
+        auto try_push = [&](std::uint32_t n, int nx, int ny) {
+            // Out-of-image neighbours hit the sentinel border
+            if (visited.test(n)) return;
+            TRIPLEFILL_COUNT(paint.telemetry().neighbour_tests, 1);
+            if (in_tolerance.test(static_cast<unsigned>(nx),
+                                  static_cast<unsigned>(ny))) {
+                visited.set(n);
+                frontier.push(n);
+            } else {
+                TRIPLEFILL_COUNT(paint.telemetry().rejected_neighbours, 1);
+            }
+        };
+
+        while (!frontier.empty()) {
+            if (paint.filled() >= limit) return false;
+
+            const std::uint32_t cur =
+                Lifo ? frontier.pop_back() : frontier.pop_front();
+            const auto row = cur / stride;
+            const int  y   = static_cast<int>(row) - 1;
+            const int  x   = static_cast<int>(cur - row * stride) - 1;
+
+            paint.pixel(x, y);
+
+            if (cfg.on_progress)
+                cfg.on_progress(paint.filled(), frontier.size());
+
+            Neighbours<C>::expand(cur, x, y, stride, try_push);
+        }
+        return true;
+    }
+
+private:
+    const FillConfig& cfg_;
+    VisitedMap&       visited_;
+    Frontier&         frontier_;
+    Mask&             in_tolerance_;
+    Paint&            paint_;
+    std::uint32_t     stride_;
+};
+
+/// Span fill: each popped seed grows into the maximal unvisited in-tolerance
+/// run on its row, the run is marked and painted left to right, and the rows
+/// above and below are scanned over the run's extent (one pixel wider each
+/// side for diagonal connectivity) pushing one seed per contiguous candidate
+/// run. A run cut short by the limit is finished by the
+/// next advance() before its neighbouring rows are scanned, so stepping does
+/// not change the fill order.
+template <Connectivity C, class Paint, class Mask = ToleranceMask>
+class ScanlineWalk {
+public:
+    ScanlineWalk(const FillConfig& cfg, VisitedMap& visited, Frontier& seeds,
+                 Mask& in_tolerance, Paint& paint)
+        : cfg_(cfg), visited_(visited), seeds_(seeds),
+          in_tolerance_(in_tolerance), paint_(paint),
+          h_(static_cast<int>(visited.height())),
+          stride_(static_cast<std::uint32_t>(visited.stride())) {
+        seeds_.push(
+            static_cast<std::uint32_t>(visited.index(cfg.seed.x, cfg.seed.y)));
+    }
+
+    bool advance(std::size_t limit) {
+        for (;;) {
+            if (pending_) {
+                const std::size_t room = limit - std::min(limit, paint_.filled());
+                if (room == 0) return false;
+                const std::size_t left = static_cast<std::size_t>(xr_ - x_) + 1;
+                const int end = x_ + static_cast<int>(std::min(left, room)) - 1;
+                paint_.run(y_, x_, end);
+                x_ = end + 1;
+                if (x_ <= xr_) return false;
+                pending_ = false;
+
+                if (cfg_.on_progress)
+                    cfg_.on_progress(paint_.filled(), seeds_.size());
+
+                constexpr int reach = Neighbours<C>::row_reach;
+                scan_row(xl_ - reach, xr_ + reach, y_ - 1);
+                scan_row(xl_ - reach, xr_ + reach, y_ + 1);
+            }
+
+            if (seeds_.empty()) return true;
+
+            const std::uint32_t s = seeds_.pop_back();
+            // The same run can be seeded from both neighbouring rows.
+            if (visited_.test(s)) continue;
+            // Stale seeds are dropped first, so a walk paused at the limit
+            // always has pixels left to paint.
+            if (paint_.filled() >= limit) {
+                seeds_.push(s);
+                return false;
+            }
+
+            const auto row = s / stride_;
+            y_  = static_cast<int>(row) - 1;
+            xl_ = static_cast<int>(s - row * stride_) - 1;
+            xr_ = xl_;
+            while (open(xl_ - 1, y_)) --xl_;
+            while (open(xr_ + 1, y_)) ++xr_;
+
+            visited_.set_run(y_, xl_, xr_);
+            x_       = xl_;
+            pending_ = true;
+        }
+    }
+
+private:
+    // The sentinel border reads as visited, so run growth and row scans
+    // never step outside the image.
+    bool open(int x, int y) {
+        if (visited_.test(x, y)) return false;
+        TRIPLEFILL_COUNT(paint_.telemetry().neighbour_tests, 1);
+        const bool in = in_tolerance_.test(static_cast<unsigned>(x),
+                                           static_cast<unsigned>(y));
+        if (!in) TRIPLEFILL_COUNT(paint_.telemetry().rejected_neighbours, 1);
+        return in;
+    }
+
+    void scan_row(int xl, int xr, int y) {
+        if (y < 0 || y >= h_) return;
+        bool in_run = false;
+        for (int x = xl; x <= xr; ++x) {
+            if (open(x, y)) {
+                if (!in_run)
+                    seeds_.push(static_cast<std::uint32_t>(visited_.index(x, y)));
+                in_run = true;
+            } else {
+                in_run = false;
+            }
+        }
+    }
+
+    const FillConfig& cfg_;
+    VisitedMap&       visited_;
+    Frontier&         seeds_;
+    Mask&             in_tolerance_;
+    Paint&            paint_;
+    int               h_;
+    std::uint32_t     stride_;
+
+    // Run being painted: [xl_, xr_] of row y_, painted up to x_.
+    bool pending_ = false;
+    int  y_ = 0, xl_ = 0, xr_ = 0, x_ = 0;
+};
+
+/// Advance `walk` until it completes or `limit` pixels are filled in total,
+/// applying cfg's pixel budget, cancel token and deadline. Returns why the
+/// walk stopped, or nullopt when it paused at `limit` with work left.
+template <class Walk, class Paint>
+std::optional<StopReason> drive(Walk& walk, const Paint& paint,
+                                const FillConfig& cfg, std::size_t limit) {
+    const std::size_t budget =
+        cfg.max_pixels.value_or(std::numeric_limits<std::size_t>::max());
+    const std::size_t stop   = std::min(limit, budget);
+    const bool        polled = cfg.cancel || cfg.deadline;
+
+    for (;;) {
+        std::size_t next = stop;
+        if (polled) {
+            if (const auto r = interrupted(cfg)) return r;
+            next = stop - paint.filled() > stop_check_interval
+                       ? paint.filled() + stop_check_interval
+                       : stop;
+        }
+        if (walk.advance(next)) return StopReason::Complete;
+        if (paint.filled() >= stop) {
+            if (paint.filled() >= budget) return StopReason::PixelBudget;
+            return std::nullopt;
+        }
+    }
+}
+
+/// Call fn with the walk type for `algorithm` (not Parallel), connectivity
+/// C, painter `Paint` and tolerance test `Mask`.
+template <class Paint, Connectivity C, class Mask = ToleranceMask, class Fn>
+decltype(auto) visit_walk(Algorithm algorithm, Fn&& fn) {
+    switch (algorithm) {
+    case Algorithm::DFS:
+        return fn(std::type_identity<QueueWalk<true, C, Paint, Mask>>{});
+    case Algorithm::Scanline:
+        return fn(std::type_identity<ScanlineWalk<C, Paint, Mask>>{});
+    default:
+        return fn(std::type_identity<QueueWalk<false, C, Paint, Mask>>{});
+    }
+}
+
+// ---- entry points ----------------------------------------------------------
+//
+// Each connectivity's kernels are compiled in their own translation units
+// (fill_walk_*.cpp for flood_fill, fill_stepper_*.cpp for FillSession). With
+// more (walk, picker) combinations in one unit the compiler exhausts its
+// inlining budget and stops inlining the per-pixel helpers.
+
+struct WalkResult {
+    std::size_t   filled = 0;
+    StopReason    stop   = StopReason::Complete;
+    FillTelemetry telemetry{};
+    /// Intermediate frames sent.
+    std::size_t   captured = 0;
+    /// Offsets painted after the last stored frame, when tracked.
+    std::optional<std::vector<std::uint32_t>> changes;
+};
+
+/// fill_into's BFS / DFS / Scanline path for connectivity C: paints the
+/// region of cfg.seed onto `canvas`, sending intermediate frames to `out`.
+template <Connectivity C>
+WalkResult run_walk(Image& canvas, FrameSink& out, const FillConfig& cfg,
+                    VisitedMap& visited, Frontier& frontier,
+                    ToleranceMask& in_tolerance) {
+    WalkResult r;
+    r.filled = visit_picker(
+        cfg.picker, visited, canvas.width(), canvas.height(), [&](auto pick) {
+            Painter paint(canvas, out, cfg, pick);
+            {
+                TRIPLEFILL_TIME_PHASE(paint.telemetry().traverse_seconds);
+                visit_walk<decltype(paint), C>(cfg.algorithm, [&](auto walk_type) {
+                    typename decltype(walk_type)::type walk(
+                        cfg, visited, frontier, in_tolerance, paint);
+                    r.stop = *drive(walk, paint, cfg,
+                                    std::numeric_limits<std::size_t>::max());
+                });
+            }
+            r.telemetry = paint.telemetry();
+            r.captured  = paint.captured();
+            if (auto* changes = paint.changes())
+                r.changes = std::move(*changes);
+            return paint.filled();
+        });
+    return r;
+}
+
+extern template WalkResult run_walk<Connectivity::Four>(
+    Image&, FrameSink&, const FillConfig&, VisitedMap&, Frontier&,
+    ToleranceMask&);
+extern template WalkResult run_walk<Connectivity::Eight>(
+    Image&, FrameSink&, const FillConfig&, VisitedMap&, Frontier&,
+    ToleranceMask&);
+
+} // namespace triplefill::detail
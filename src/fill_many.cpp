@@ -0,0 +1,154 @@
+#include "triplefill/fill.hpp"
+#include "fill_internal.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+namespace triplefill {
+
+namespace {
+
+/// A completed fill's region, keyed by what determines it.
+struct Region {
+    RGBA         seed_color;
+    double       tolerance;
+    Connectivity connectivity;
+    ColorMetric  metric;
+    VisitedMap   pixels;
+    std::size_t count;
+};
+
+RGBA seed_color_of(const Image& img, const FillConfig& cfg) {
+    return img.at(static_cast<unsigned>(cfg.seed.x),
+                  static_cast<unsigned>(cfg.seed.y));
+}
+
+class RegionCache {
+public:
+    const Region* find(const RGBA& seed_color, const FillConfig& cfg) const {
+        std::lock_guard lock(mu_);
+        for (const auto& r : regions_) {
+            if (r->seed_color == seed_color && r->tolerance == cfg.tolerance &&
+                r->connectivity == cfg.connectivity &&
+                r->metric == cfg.metric &&
+                r->pixels.test(cfg.seed.x, cfg.seed.y))
+                return r.get();
+        }
+        return nullptr;
+    }
+
+    void add(std::unique_ptr<const Region> r) {
+        std::lock_guard lock(mu_);
+        regions_.push_back(std::move(r));
+    }
+
+private:
+    mutable std::mutex mu_;
+    // Regions are immutable once added and never removed, so pointers
+    // returned by find() stay valid for the cache's lifetime.
+    std::vector<std::unique_ptr<const Region>> regions_;
+};
+
+/// Per-worker scratch: one visited map and frontier, plus tolerance masks
+/// for the most recent (seed colour, tolerance, metric) keys so lazily
+/// evaluated segments carry over. Each mask holds image-sized bits and
+/// maybe a colour memo table, so only a few are kept.
+class Scratch {
+public:
+    static constexpr std::size_t kept_masks = 4;
+
+    Scratch(unsigned w, unsigned h) : visited(w, h), frontier(w, h) {}
+
+    ToleranceMask& mask_for(const Image& img, const RGBA& seed_color,
+                            double tolerance, ColorMetric metric) {
+        auto it = std::find_if(masks_.begin(), masks_.end(), [&](const Entry& m) {
+            return m.seed_color == seed_color && m.tolerance == tolerance &&
+                   m.metric == metric;
+        });
+        if (it == masks_.end()) {
+            if (masks_.size() == kept_masks) masks_.pop_back();
+            masks_.insert(masks_.begin(),
+                          {seed_color, tolerance, metric,
+                           std::make_unique<ToleranceMask>(img, seed_color,
+                                                           tolerance, metric)});
+        } else {
+            std::rotate(masks_.begin(), it, it + 1);
+        }
+        return *masks_.front().mask;
+    }
+
+    VisitedMap       visited;
+    detail::Frontier frontier;
+
+private:
+    struct Entry {
+        RGBA        seed_color;
+        double      tolerance;
+        ColorMetric metric;
+        std::unique_ptr<ToleranceMask> mask;
+    };
+    std::vector<Entry> masks_; // most recently used first
+};
+
+} // namespace
+
+std::vector<Animation> flood_fill_many(const Image& img,
+                                       std::span<const FillConfig> cfgs,
+                                       unsigned threads) {
+    const std::size_t n = cfgs.size();
+    std::vector<Animation> out(n);
+
+    // Only keep a region around when another config could reuse it.
+    std::vector<std::uint8_t> worth_caching(n, 0);
+    for (std::size_t i = 0; i < n; ++i) {
+        if (!detail::seed_in_bounds(img, cfgs[i].seed)) continue;
+        const RGBA ci = seed_color_of(img, cfgs[i]);
+        for (std::size_t j = 0; j < n && !worth_caching[i]; ++j) {
+            worth_caching[i] =
+                j != i && detail::order_independent(cfgs[j]) &&
+                detail::seed_in_bounds(img, cfgs[j].seed) &&
+                seed_color_of(img, cfgs[j]) == ci &&
+                cfgs[j].tolerance == cfgs[i].tolerance &&
+                cfgs[j].connectivity == cfgs[i].connectivity &&
+                cfgs[j].metric == cfgs[i].metric;
+        }
+    }
+
+    RegionCache cache;
+    std::atomic<std::size_t> next{0};
+    const std::size_t workers =
+        std::min<std::size_t>(detail::resolve_threads(threads), n);
+
+    detail::run_workers(workers, [&] {
+        Scratch scratch(img.width(), img.height());
+        for (std::size_t i; (i = next.fetch_add(1, std::memory_order_relaxed)) < n;) {
+            const FillConfig& cfg = cfgs[i];
+            if (!detail::seed_in_bounds(img, cfg.seed)) continue;
+
+            const RGBA seed_color = seed_color_of(img, cfg);
+            if (detail::order_independent(cfg)) {
+                if (const Region* r = cache.find(seed_color, cfg)) {
+                    out[i] = detail::paint_region(img, cfg, r->pixels, r->count);
+                    continue;
+                }
+            }
+
+            scratch.visited.reset();
+            out[i] = detail::fill_into(
+                img, cfg, scratch.visited, scratch.frontier,
+                scratch.mask_for(img, seed_color, cfg.tolerance, cfg.metric),
+                worth_caching[i] != 0);
+
+            if (worth_caching[i] && !out[i].stats().truncated()) {
+                cache.add(std::make_unique<const Region>(
+                    Region{seed_color, cfg.tolerance, cfg.connectivity,
+                           cfg.metric, scratch.visited, out[i].stats().filled_pixels}));
+            }
+        }
+    });
+
+    return out;
+}
+
+} // namespace triplefill
@@ -0,0 +1,242 @@
+#include "fill_internal.hpp"
+#include "telemetry.hpp"
+
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+
+namespace triplefill::detail {
+
+namespace {
+
+using Label = std::uint32_t;
+constexpr Label no_label = std::numeric_limits<Label>::max();
+
+// Tiles are one tolerance-mask segment wide, so each mask segment is only
+// ever evaluated by the thread that owns its tile.
+constexpr unsigned tile_w = ToleranceMask::segment_size;
+constexpr unsigned tile_h = 256;
+
+/// Lock-free union-find over per-pixel parent labels. Roots always link to
+/// the smaller label, so parent[i] <= i holds throughout and path halving
+/// can race freely with linking.
+class UnionFind {
+public:
+    explicit UnionFind(std::size_t n) : parent_(new std::atomic<Label>[n]) {}
+
+    void make(std::size_t i, Label v) {
+        parent_[i].store(v, std::memory_order_relaxed);
+    }
+    [[nodiscard]] Label get(std::size_t i) const {
+        return parent_[i].load(std::memory_order_relaxed);
+    }
+
+    Label find(Label x) {
+        for (;;) {
+            Label p = parent_[x].load(std::memory_order_relaxed);
+            if (p == x) return x;
+            const Label gp = parent_[p].load(std::memory_order_relaxed);
+            if (gp != p)
+                parent_[x].compare_exchange_weak(p, gp,
+                                                 std::memory_order_relaxed);
+            x = gp;
+        }
+    }
+
+    void unite(Label a, Label b) {
+        for (;;) {
+            a = find(a);
+            b = find(b);
+            if (a == b) return;
+            if (a < b) std::swap(a, b);
+            Label expected = a;
+            if (parent_[a].compare_exchange_strong(expected, b,
+                                                   std::memory_order_relaxed))
+                return;
+        }
+    }
+
+private:
+    std::unique_ptr<std::atomic<Label>[]> parent_;
+};
+
+struct Tile {
+    unsigned x0, y0, x1, y1; // half-open
+};
+
+} // namespace
+
+ParallelResult fill_parallel(Image& canvas, ToleranceMask& mask,
+                             const FillConfig& cfg, const ColorPickerFn& picker,
+                             VisitedMap& visited, bool mark_visited) {
+    const unsigned w = canvas.width();
+    const unsigned h = canvas.height();
+    const auto npx = static_cast<std::size_t>(w) * h;
+    if (npx >= no_label)
+        throw std::length_error("Parallel fill supports at most 2^32-1 pixels");
+
+    // Labelling (phases 1-3 and marking) counts as traversal.
+    FillTelemetry tel;
+    TRIPLEFILL_PHASE_START(labelling);
+
+    const Point    seed    = cfg.seed;
+    const unsigned threads = resolve_threads(cfg.threads);
+
+    // Polled once per tile; after the first stop the remaining tiles of
+    // the phase are skipped.
+    const bool polled = cfg.cancel || cfg.deadline;
+    std::atomic<int> stop{static_cast<int>(StopReason::Complete)};
+    auto stopped = [&] {
+        if (!polled) return false;
+        if (stop.load(std::memory_order_relaxed) !=
+            static_cast<int>(StopReason::Complete))
+            return true;
+        if (const auto r = interrupted(cfg)) {
+            stop.store(static_cast<int>(*r), std::memory_order_relaxed);
+            return true;
+        }
+        return false;
+    };
+    auto stop_reason = [&] {
+        return static_cast<StopReason>(stop.load(std::memory_order_relaxed));
+    };
+    auto stopped_early = [&](StopReason r) {
+        TRIPLEFILL_PHASE_END(tel.traverse_seconds, labelling);
+        return ParallelResult{0, r, tel};
+    };
+
+    std::vector<Tile> tiles;
+    for (unsigned y = 0; y < h; y += tile_h)
+        for (unsigned x = 0; x < w; x += tile_w)
+            tiles.push_back({x, y, std::min(w, x + tile_w),
+                             std::min(h, y + tile_h)});
+
+    UnionFind uf(npx);
+    auto at = [w](unsigned x, unsigned y) -> Label {
+        return static_cast<Label>(static_cast<std::size_t>(y) * w + x);
+    };
+
+    // Diagonal links are only made for Connectivity::Eight; the flag is
+    // loop-invariant, so the branches below predict perfectly.
+    const bool diagonal = cfg.connectivity == Connectivity::Eight;
+    auto link = [&](Label i, Label j) {
+        if (uf.get(j) != no_label) uf.unite(i, j);
+    };
+
+    // Phase 1: label in-tolerance components inside each tile. The seed is
+    // labelled even outside its own tolerance (negative or NaN), as the
+    // other algorithms paint it regardless.
+    const Label seed_label = at(static_cast<unsigned>(seed.x),
+                                static_cast<unsigned>(seed.y));
+    parallel_for(tiles.size(), threads, [&](std::size_t t) {
+        if (stopped()) return;
+        const Tile& tl = tiles[t];
+        for (unsigned y = tl.y0; y < tl.y1; ++y) {
+            for (unsigned x = tl.x0; x < tl.x1; ++x) {
+                const Label i = at(x, y);
+                if (i != seed_label && !mask.test(x, y)) {
+                    uf.make(i, no_label);
+                    continue;
+                }
+                uf.make(i, i);
+                if (x > tl.x0) link(i, i - 1);
+                if (y > tl.y0) {
+                    link(i, i - w);
+                    if (diagonal) {
+                        if (x > tl.x0)     link(i, i - w - 1);
+                        if (x + 1 < tl.x1) link(i, i - w + 1);
+                    }
+                }
+            }
+        }
+    });
+
+    if (stopped()) return stopped_early(stop_reason());
+
+    // Phase 2: merge labels across the top and left seams of each tile.
+    // Diagonal pairs that straddle a tile corner are covered by the top seam
+    // of the lower tile.
+    parallel_for(tiles.size(), threads, [&](std::size_t t) {
+        if (stopped()) return;
+        const Tile& tl = tiles[t];
+        if (tl.y0 > 0) {
+            for (unsigned x = tl.x0; x < tl.x1; ++x) {
+                const Label i = at(x, tl.y0);
+                if (uf.get(i) == no_label) continue;
+                link(i, i - w);
+                if (diagonal) {
+                    if (x > 0)     link(i, i - w - 1);
+                    if (x + 1 < w) link(i, i - w + 1);
+                }
+            }
+        }
+        if (tl.x0 > 0) {
+            for (unsigned y = tl.y0; y < tl.y1; ++y) {
+                const Label i = at(tl.x0, y);
+                if (uf.get(i) == no_label) continue;
+                link(i, i - 1);
+                if (diagonal) {
+                    if (y > tl.y0)     link(i, i - w - 1);
+                    if (y + 1 < tl.y1) link(i, i + w - 1);
+                }
+            }
+        }
+    });
+
+    if (stopped()) return stopped_early(stop_reason());
+
+    // Phase 3: flatten the seed's component so membership is a single
+    // compare, and count it.
+    const Label root = uf.find(seed_label);
+    std::atomic<std::size_t> filled{0};
+    parallel_for(tiles.size(), threads, [&](std::size_t t) {
+        const Tile& tl = tiles[t];
+        std::size_t n = 0;
+        for (unsigned y = tl.y0; y < tl.y1; ++y) {
+            for (unsigned x = tl.x0; x < tl.x1; ++x) {
+                const Label i = at(x, y);
+                if (uf.get(i) != no_label && uf.find(i) == root) {
+                    uf.make(i, root);
+                    ++n;
+                }
+            }
+        }
+        filled.fetch_add(n, std::memory_order_relaxed);
+    });
+
+    if (cfg.max_pixels && filled.load() > *cfg.max_pixels)
+        return stopped_early(StopReason::PixelBudget);
+    if (stopped()) return stopped_early(stop_reason());
+
+    auto member = [&](Label i) { return uf.get(i) == root; };
+
+    // Visited bits share words across tile edges, so mark them serially.
+    if (mark_visited) {
+        for (unsigned y = 0; y < h; ++y)
+            for (unsigned x = 0; x < w; ++x)
+                if (member(at(x, y)))
+                    visited.set(static_cast<int>(x), static_cast<int>(y));
+    }
+
+    TRIPLEFILL_PHASE_END(tel.traverse_seconds, labelling);
+
+    // Phase 4: paint.
+    TRIPLEFILL_TIME_PHASE(tel.paint_seconds);
+    parallel_for(tiles.size(), threads, [&](std::size_t t) {
+        const Tile& tl = tiles[t];
+        for (unsigned y = tl.y0; y < tl.y1; ++y) {
+            for (unsigned x = tl.x0; x < tl.x1; ++x) {
+                if (!member(at(x, y))) continue;
+                RGBA& px = canvas.at(x, y);
+                px = picker(Point{static_cast<int>(x), static_cast<int>(y)},
+                            px);
+            }
+        }
+    });
+
+    TRIPLEFILL_COUNT(tel.picker_calls, filled.load());
+    return {filled.load(), StopReason::Complete, tel};
+}
+
+} // namespace triplefill::detail
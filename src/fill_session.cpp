@@ -0,0 +1,176 @@
+#include "triplefill/fill_session.hpp"
+#include "triplefill/frame_generator.hpp"
+#include "fill_internal.hpp"
+#include "fill_stepper.hpp"
+#include "telemetry.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <optional>
+
+namespace triplefill {
+
+namespace {
+
+constexpr DirtyRect no_pixels{std::numeric_limits<int>::max(),
+                              std::numeric_limits<int>::max(),
+                              std::numeric_limits<int>::min(),
+                              std::numeric_limits<int>::min()};
+
+} // namespace
+
+struct FillSession::State {
+    State(const Image& img, const FillConfig& config)
+        : cfg(config), canvas(img),
+          visited(img.width(), img.height()),
+          frontier(img.width(), img.height()) {
+        if (!detail::seed_in_bounds(img, cfg.seed)) {
+            done = true;
+            return;
+        }
+
+        const unsigned w = img.width();
+        const unsigned h = img.height();
+        in_tolerance.emplace(img,
+                             img.at(static_cast<unsigned>(cfg.seed.x),
+                                    static_cast<unsigned>(cfg.seed.y)),
+                             cfg.tolerance, cfg.metric);
+        if (cfg.algorithm == Algorithm::Parallel) return;
+
+        detail::check_frontier_range(w, h);
+        stepper = cfg.connectivity == Connectivity::Eight
+                      ? detail::make_stepper<Connectivity::Eight>(
+                            cfg, canvas, visited, frontier, *in_tolerance, dirty)
+                      : detail::make_stepper<Connectivity::Four>(
+                            cfg, canvas, visited, frontier, *in_tolerance, dirty);
+    }
+
+    /// Algorithm::Parallel in one go, tracking the dirty rectangle through
+    /// the type-erased picker it takes.
+    void run_parallel() {
+        const unsigned w = canvas.width();
+        const unsigned h = canvas.height();
+        ColorPickerFn pick = detail::build_picker(cfg.picker, visited, w, h);
+        ColorPickerFn tracked = detail::TrackPick<ColorPickerFn>{pick, &dirty};
+        const auto r = detail::fill_parallel(
+            canvas, *in_tolerance, cfg, tracked, visited,
+            std::holds_alternative<BorderPicker>(cfg.picker));
+        parallel_filled = r.filled;
+        stop            = r.stop;
+        detail::accumulate(telemetry, r.telemetry);
+        if (cfg.on_progress)
+            cfg.on_progress(parallel_filled, 0);
+    }
+
+    [[nodiscard]] std::size_t filled() const noexcept {
+        return stepper ? stepper->filled() : parallel_filled;
+    }
+
+    FillConfig                   cfg;
+    Image                        canvas;
+    VisitedMap                   visited;
+    detail::Frontier             frontier;
+    std::optional<ToleranceMask> in_tolerance;
+    std::unique_ptr<detail::Stepper> stepper;
+    DirtyRect                    dirty;
+    FillTelemetry                telemetry; // setup and Parallel
+    std::size_t                  parallel_filled = 0;
+    std::size_t                  captured        = 0;
+    StopReason                   stop            = StopReason::Complete;
+    bool                         done            = false;
+};
+
+FillSession::FillSession(const Image& img, const FillConfig& cfg) {
+    [[maybe_unused]] double setup_seconds = 0;
+    {
+        TRIPLEFILL_TIME_PHASE(setup_seconds);
+        state_ = std::make_unique<State>(img, cfg);
+    }
+    TRIPLEFILL_COUNT(state_->telemetry.setup_seconds, setup_seconds);
+}
+
+FillSession::~FillSession() = default;
+FillSession::FillSession(FillSession&&) noexcept = default;
+FillSession& FillSession::operator=(FillSession&&) noexcept = default;
+
+FillStep FillSession::step(std::size_t max_pixels) {
+    State& s = *state_;
+    FillStep out;
+    if (s.done) {
+        out.done = true;
+        return out;
+    }
+
+    s.dirty = no_pixels;
+    const std::size_t before = s.filled();
+    if (s.stepper) {
+        const std::size_t budget = std::max<std::size_t>(max_pixels, 1);
+        const std::size_t limit =
+            budget > std::numeric_limits<std::size_t>::max() - before
+                ? std::numeric_limits<std::size_t>::max()
+                : before + budget;
+        if (const auto r = s.stepper->advance(limit, out.frames)) {
+            s.stop = *r;
+            s.done = true;
+        }
+    } else {
+        s.run_parallel();
+        s.done = true;
+    }
+
+    out.painted = s.filled() - before;
+    if (out.painted) out.dirty = s.dirty;
+    out.done = s.done;
+    s.captured += out.frames.size();
+    return out;
+}
+
+bool FillSession::done() const noexcept { return state_->done; }
+
+const Image& FillSession::canvas() const noexcept { return state_->canvas; }
+
+FillStats FillSession::stats() const noexcept {
+    const State& s = *state_;
+    FillTelemetry tel = s.telemetry;
+    if (s.stepper) detail::accumulate(tel, s.stepper->telemetry());
+    if (s.in_tolerance) {
+        TRIPLEFILL_COUNT(tel.tolerance_evaluations,
+                         s.in_tolerance->evaluated_pixels());
+        TRIPLEFILL_COUNT(tel.memo_hits, s.in_tolerance->memo_hits());
+    }
+    return {s.filled(), s.captured, s.frontier.peak(), s.stop, tel};
+}
+
+FrameGenerator flood_fill_frames(const Image& img, FillConfig cfg) {
+    // The session captures nothing itself; it is stepped to each frame
+    // boundary and the canvas is yielded in place.
+    const std::size_t freq =
+        cfg.algorithm == Algorithm::Parallel || cfg.frame_freq <= 0
+            ? 0
+            : static_cast<std::size_t>(cfg.frame_freq);
+    const auto max_frames = cfg.max_frames;
+    cfg.frame_freq = 0;
+
+    FillSession session(img, cfg);
+    if (session.done()) co_return;
+
+    std::size_t yielded = 0;
+    while (freq && !session.done() &&
+           (!max_frames || yielded < *max_frames)) {
+        const std::size_t target = (yielded + 1) * freq;
+        std::size_t filled = session.stats().filled_pixels;
+        while (!session.done() && filled < target) {
+            session.step(target - filled);
+            filled = session.stats().filled_pixels;
+        }
+        if (filled < target) break;
+        ++yielded;
+        co_yield session.canvas();
+    }
+
+    while (!session.done())
+        session.step(std::numeric_limits<std::size_t>::max());
+    co_yield session.canvas();
+}
+
+} // namespace triplefill
@@ -0,0 +1,103 @@
+#pragma once
+
+// Type-erased, resumable kernels behind FillSession. Not part of the public
+// API.
+
+#include "fill_kernel.hpp"
+#include "triplefill/fill_session.hpp"
+
+#include <algorithm>
+#include <memory>
+#include <optional>
+#include <vector>
+
+namespace triplefill::detail {
+
+/// Kernel picker that also grows the current step's dirty rectangle.
+template <class Pick>
+struct TrackPick {
+    Pick       inner;
+    DirtyRect* dirty;
+
+    RGBA operator()(Point pt, const RGBA& orig) const {
+        dirty->x0 = std::min(dirty->x0, pt.x);
+        dirty->y0 = std::min(dirty->y0, pt.y);
+        dirty->x1 = std::max(dirty->x1, pt.x + 1);
+        dirty->y1 = std::max(dirty->y1, pt.y + 1);
+        return inner(pt, orig);
+    }
+};
+
+/// Type-erased (walk, picker) kernel; one virtual call per step.
+class Stepper {
+public:
+    virtual ~Stepper() = default;
+
+    /// Advance until `limit` pixels are filled in total, capturing frames
+    /// into `frames`. Returns why the fill ended, or nullopt if it paused.
+    virtual std::optional<StopReason> advance(std::size_t limit,
+                                              std::vector<Image>& frames) = 0;
+    [[nodiscard]] virtual std::size_t filled() const noexcept = 0;
+    [[nodiscard]] virtual const FillTelemetry& telemetry() const noexcept = 0;
+};
+
+template <class Walk, class Pick>
+class WalkStepper final : public Stepper {
+public:
+    WalkStepper(const FillConfig& cfg, Image& canvas, VisitedMap& visited,
+                Frontier& frontier, ToleranceMask& in_tolerance, Pick pick)
+        : cfg_(cfg), frames_(), out_(frames_), paint_(canvas, out_, cfg, pick),
+          walk_(cfg, visited, frontier, in_tolerance, paint_) {}
+
+    std::optional<StopReason> advance(std::size_t limit,
+                                      std::vector<Image>& frames) override {
+        out_.reset(frames);
+        TRIPLEFILL_TIME_PHASE(paint_.telemetry().traverse_seconds);
+        return drive(walk_, paint_, cfg_, limit);
+    }
+
+    [[nodiscard]] std::size_t filled() const noexcept override {
+        return paint_.filled();
+    }
+    [[nodiscard]] const FillTelemetry& telemetry() const noexcept override {
+        return paint_.telemetry();
+    }
+
+private:
+    const FillConfig&  cfg_;
+    std::vector<Image> frames_; // sink until the first step
+    VectorOut          out_;
+    Painter<Pick>      paint_;
+    Walk               walk_;
+};
+
+/// A stepper for cfg's picker and algorithm (not Parallel) with connectivity
+/// C, painting onto `canvas` and growing `dirty`. Instantiated in
+/// fill_stepper_*.cpp, one translation unit per connectivity.
+template <Connectivity C>
+std::unique_ptr<Stepper> make_stepper(const FillConfig& cfg, Image& canvas,
+                                      VisitedMap& visited, Frontier& frontier,
+                                      ToleranceMask& in_tolerance,
+                                      DirtyRect& dirty) {
+    return visit_picker(
+        cfg.picker, visited, canvas.width(), canvas.height(),
+        [&](auto pick) -> std::unique_ptr<Stepper> {
+            using Pick = TrackPick<decltype(pick)>;
+            return visit_walk<Painter<Pick>, C>(
+                cfg.algorithm, [&](auto walk_type) -> std::unique_ptr<Stepper> {
+                    using Walk = typename decltype(walk_type)::type;
+                    return std::make_unique<WalkStepper<Walk, Pick>>(
+                        cfg, canvas, visited, frontier, in_tolerance,
+                        Pick{pick, &dirty});
+                });
+        });
+}
+
+extern template std::unique_ptr<Stepper> make_stepper<Connectivity::Four>(
+    const FillConfig&, Image&, VisitedMap&, Frontier&, ToleranceMask&,
+    DirtyRect&);
+extern template std::unique_ptr<Stepper> make_stepper<Connectivity::Eight>(
+    const FillConfig&, Image&, VisitedMap&, Frontier&, ToleranceMask&,
+    DirtyRect&);
+
+} // namespace triplefill::detail
@@ -0,0 +1,12 @@
+// Connectivity::Eight kernels for FillSession; see "entry points" in
+// fill_kernel.hpp.
+
+#include "fill_stepper.hpp"
+
+namespace triplefill::detail {
+
+template std::unique_ptr<Stepper> make_stepper<Connectivity::Eight>(
+    const FillConfig&, Image&, VisitedMap&, Frontier&, ToleranceMask&,
+    DirtyRect&);
+
+} // namespace triplefill::detail
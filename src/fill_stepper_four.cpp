@@ -0,0 +1,12 @@
+// Connectivity::Four kernels for FillSession; see "entry points" in
+// fill_kernel.hpp.
+
+#include "fill_stepper.hpp"
+
+namespace triplefill::detail {
+
+template std::unique_ptr<Stepper> make_stepper<Connectivity::Four>(
+    const FillConfig&, Image&, VisitedMap&, Frontier&, ToleranceMask&,
+    DirtyRect&);
+
+} // namespace triplefill::detail
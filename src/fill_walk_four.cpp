@@ -0,0 +1,12 @@
+// Connectivity::Four kernels for flood_fill; see "entry points" in
+// fill_kernel.hpp.
+
+#include "fill_kernel.hpp"
+
+namespace triplefill::detail {
+
+template WalkResult run_walk<Connectivity::Four>(
+    Image&, FrameSink&, const FillConfig&, VisitedMap&, Frontier&,
+    ToleranceMask&);
+
+} // namespace triplefill::detail
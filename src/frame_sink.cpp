@@ -0,0 +1,125 @@
+#include "triplefill/frame_sink.hpp"
+#include "gif.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <stdexcept>
+
+namespace triplefill {
+
+// ---- Animation -------------------------------------------------------------
+
+void AnimationSink::frame(const Image& canvas, Changes changed) {
+    if (changed)
+        anim_.add_frame(canvas, *changed);
+    else
+        anim_.add_frame(Image(canvas));
+}
+
+void AnimationSink::final_frame(Image&& canvas, Changes changed) {
+    if (changed && !anim_.empty())
+        anim_.add_frame(std::move(canvas), *changed);
+    else
+        anim_.add_frame(std::move(canvas));
+}
+
+// ---- GIF -------------------------------------------------------------------
+
+/// An open GIF of a fixed size; frames of any layout.
+class GifSink::Writer {
+public:
+    Writer(const std::filesystem::path& path, unsigned w, unsigned h,
+           unsigned delay_cs)
+        : w_(w), h_(h), delay_cs_(delay_cs) {
+        if (!gif_begin(&gw_, path.string().c_str(),
+                       static_cast<int>(w), static_cast<int>(h),
+                       static_cast<uint16_t>(delay_cs)))
+            throw std::runtime_error("Cannot open GIF file: " + path.string());
+    }
+    ~Writer() { gif_end(&gw_); }
+
+    Writer(const Writer&) = delete;
+    Writer& operator=(const Writer&) = delete;
+
+    void write(const Image& frame) {
+        if (frame.width() != w_ || frame.height() != h_)
+            throw std::runtime_error("Frame size does not match the GIF");
+        const Image* src = &frame;
+        if (frame.layout() != Layout::RowMajor) {
+            row_major_ = frame.converted(Layout::RowMajor);
+            src = &row_major_;
+        }
+        if (!gif_write_frame(&gw_,
+                             reinterpret_cast<const uint8_t*>(src->data()),
+                             static_cast<int>(w_), static_cast<int>(h_),
+                             static_cast<uint16_t>(delay_cs_)))
+            throw std::runtime_error("Failed writing GIF frame");
+    }
+
+private:
+    GifWriter gw_;
+    unsigned  w_;
+    unsigned  h_;
+    unsigned  delay_cs_;
+    Image     row_major_;
+};
+
+GifSink::GifSink(std::filesystem::path path, unsigned delay_cs)
+    : path_(std::move(path)), delay_cs_(delay_cs) {}
+
+GifSink::~GifSink() = default;
+
+void GifSink::frame(const Image& canvas, Changes) {
+    if (!writer_) {
+        if (frames_)
+            throw std::runtime_error("GIF already closed: " + path_.string());
+        writer_ = std::make_unique<Writer>(path_, canvas.width(),
+                                           canvas.height(), delay_cs_);
+    }
+    writer_->write(canvas);
+    ++frames_;
+}
+
+void GifSink::close() {
+    if (!frames_)
+        throw std::runtime_error("Animation has no frames");
+    writer_.reset();
+}
+
+// ---- PNG sequence ----------------------------------------------------------
+
+PngSequenceSink::PngSequenceSink(std::filesystem::path dir, std::string prefix)
+    : dir_(std::move(dir)), prefix_(std::move(prefix)) {}
+
+void PngSequenceSink::frame(const Image& canvas, Changes) {
+    char index[24];
+    std::snprintf(index, sizeof(index), "%05zu.png", frames_);
+    save_png(dir_ / (prefix_ + index), canvas);
+    ++frames_;
+}
+
+// ---- raw -------------------------------------------------------------------
+
+void RawSink::frame(const Image& canvas, Changes) {
+    const auto row_bytes =
+        static_cast<std::streamsize>(canvas.width() * sizeof(RGBA));
+    if (canvas.layout() == Layout::RowMajor) {
+        out_.write(reinterpret_cast<const char*>(canvas.data()),
+                   row_bytes * canvas.height());
+    } else {
+        row_.resize(canvas.width());
+        for (unsigned y = 0; y < canvas.height(); ++y) {
+            for (unsigned x = 0; x < canvas.width();) {
+                const unsigned n = canvas.contiguous_run(x, y);
+                std::copy_n(&canvas.at(x, y), n, row_.data() + x);
+                x += n;
+            }
+            out_.write(reinterpret_cast<const char*>(row_.data()), row_bytes);
+        }
+    }
+    if (!out_)
+        throw std::runtime_error("Failed writing raw frame");
+    ++frames_;
+}
+
+} // namespace triplefill
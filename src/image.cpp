@@ -0,0 +1,58 @@
+#include "triplefill/image.hpp"
+
+#include <algorithm>
+
+namespace triplefill {
+
+namespace {
+
+/// Tiled storage is padded to whole blocks.
+std::size_t storage_size(unsigned w, unsigned h, Layout layout) {
+    if (layout == Layout::RowMajor) return static_cast<std::size_t>(w) * h;
+    const std::size_t tw = (w + Image::tile_size - 1) >> Image::tile_shift;
+    const std::size_t th = (h + Image::tile_size - 1) >> Image::tile_shift;
+    return (tw * th) << (2 * Image::tile_shift);
+}
+
+} // namespace
+
+Image::Image(unsigned w, unsigned h, RGBA fill, Layout layout)
+    : w_(w), h_(h), layout_(layout),
+      tiles_x_((w + tile_size - 1) >> tile_shift),
+      pixels_(storage_size(w, h, layout), fill) {}
+
+Image Image::converted(Layout layout) const {
+    if (layout == layout_) return *this;
+
+    Image out(w_, h_, layout);
+    // Copy in contiguous pieces of the source; the destination offset of
+    // each piece is contiguous too, because both layouts keep a row of one
+    // block in consecutive storage.
+    for (unsigned y = 0; y < h_; ++y) {
+        for (unsigned x = 0; x < w_;) {
+            const unsigned n = std::min(contiguous_run(x, y),
+                                        out.contiguous_run(x, y));
+            std::copy_n(&at(x, y), n, &out.at(x, y));
+            x += n;
+        }
+    }
+    return out;
+}
+
+bool Image::operator==(const Image& other) const {
+    if (w_ != other.w_ || h_ != other.h_) return false;
+    if (layout_ == other.layout_ && layout_ == Layout::RowMajor)
+        return pixels_ == other.pixels_;
+    for (unsigned y = 0; y < h_; ++y) {
+        for (unsigned x = 0; x < w_;) {
+            const unsigned n = std::min(contiguous_run(x, y),
+                                        other.contiguous_run(x, y));
+            if (!std::equal(&at(x, y), &at(x, y) + n, &other.at(x, y)))
+                return false;
+            x += n;
+        }
+    }
+    return true;
+}
+
+} // namespace triplefill
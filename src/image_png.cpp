@@ -23,6 +23,11 @@ Image load_png(const std::filesystem::path& path) {
 }
 
 void save_png(const std::filesystem::path& path, const Image& img) {
+    if (img.layout() != Layout::RowMajor) {
+        save_png(path, img.converted(Layout::RowMajor));
+        return;
+    }
+
     const std::size_t npx = img.pixel_count();
     std::vector<unsigned char> raw(npx * 4);
     for (std::size_t i = 0; i < npx; ++i) {
@@ -0,0 +1,306 @@
+#include "triplefill/paged_fill.hpp"
+#include "fill_internal.hpp"
+#include "fill_kernel.hpp"
+#include "telemetry.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace triplefill {
+
+namespace {
+
+constexpr unsigned tile_shift = 8;
+constexpr unsigned tile_mask  = paged_tile_size - 1;
+static_assert(paged_tile_size == 1u << tile_shift);
+static_assert(sizeof(RGBA) == 4);
+
+/// Headerless row-major RGBA file, read and written a row segment at a time.
+class RawFile {
+public:
+    RawFile(const std::filesystem::path& path, unsigned w, unsigned h)
+        : w_(w) {
+        const auto expected =
+            static_cast<std::uintmax_t>(w) * h * sizeof(RGBA);
+        if (std::filesystem::file_size(path) != expected)
+            throw std::runtime_error("Raw image file has the wrong size: " +
+                                     path.string());
+        f_.open(path, std::ios::in | std::ios::out | std::ios::binary);
+        if (!f_)
+            throw std::runtime_error("Cannot open raw image file: " +
+                                     path.string());
+    }
+
+    /// Pixels [x, x + n) of row y.
+    void read(unsigned x, unsigned y, std::size_t n, RGBA* dst) {
+        f_.seekg(offset(x, y));
+        f_.read(reinterpret_cast<char*>(dst),
+                static_cast<std::streamsize>(n * sizeof(RGBA)));
+        if (!f_) throw std::runtime_error("Failed to read raw image file");
+    }
+
+    void write(unsigned x, unsigned y, std::size_t n, const RGBA* src) {
+        f_.seekp(offset(x, y));
+        f_.write(reinterpret_cast<const char*>(src),
+                 static_cast<std::streamsize>(n * sizeof(RGBA)));
+        if (!f_) throw std::runtime_error("Failed to write raw image file");
+    }
+
+    void flush() {
+        f_.flush();
+        if (!f_) throw std::runtime_error("Failed to write raw image file");
+    }
+
+private:
+    [[nodiscard]] std::streamoff offset(unsigned x, unsigned y) const {
+        return static_cast<std::streamoff>(
+            (static_cast<std::uint64_t>(y) * w_ + x) * sizeof(RGBA));
+    }
+
+    std::fstream f_;
+    unsigned     w_;
+};
+
+/// A resident tile and the tolerance verdicts of its pixels.
+struct Tile {
+    unsigned      tx = 0;
+    unsigned      ty = 0;
+    Image         pixels;
+    std::optional<ToleranceMask> mask;
+    std::uint64_t last_use = 0;
+    bool          dirty    = false;
+};
+
+/// Least-recently-used set of at most `capacity` resident tiles (0 = three
+/// rows of tiles).
+///
+/// Tiles are read from the file being filled, so a tile paged back in shows
+/// the pixels already painted. Its mask then rates painted pixels, but
+/// those are all visited, and the walks test the visited map first.
+class TileCache {
+public:
+    TileCache(RawFile& file, unsigned w, unsigned h, const RGBA& seed,
+              double tolerance, ColorMetric metric, std::size_t capacity)
+        : file_(file), w_(w), h_(h), seed_(seed), tolerance_(tolerance),
+          metric_(metric),
+          tiles_x_((w + tile_mask) >> tile_shift),
+          capacity_(capacity ? capacity : 3 * std::size_t{tiles_x_}),
+          slot_of_(static_cast<std::size_t>(tiles_x_) *
+                       ((h + tile_mask) >> tile_shift),
+                   -1) {}
+
+    /// The tile holding pixel (x, y), paged in if needed.
+    Tile& get(unsigned x, unsigned y) {
+        const unsigned tx = x >> tile_shift;
+        const unsigned ty = y >> tile_shift;
+        if (last_ && last_->tx == tx && last_->ty == ty) return *last_;
+        last_ = &fetch(tx, ty);
+        return *last_;
+    }
+
+    /// Write every painted tile back to the file.
+    void flush() {
+        for (auto& t : slots_)
+            if (t->dirty) write_back(*t);
+        file_.flush();
+    }
+
+private:
+    Tile& fetch(unsigned tx, unsigned ty) {
+        std::int32_t& slot = slot_of_[key(tx, ty)];
+        if (slot < 0) {
+            if (slots_.size() < capacity_) {
+                slots_.push_back(std::make_unique<Tile>());
+                slot = static_cast<std::int32_t>(slots_.size() - 1);
+            } else {
+                const auto lru = std::min_element(
+                    slots_.begin(), slots_.end(),
+                    [](const auto& a, const auto& b) {
+                        return a->last_use < b->last_use;
+                    });
+                Tile& victim = **lru;
+                if (victim.dirty) write_back(victim);
+                slot_of_[key(victim.tx, victim.ty)] = -1;
+                slot = static_cast<std::int32_t>(lru - slots_.begin());
+            }
+            load(*slots_[static_cast<std::size_t>(slot)], tx, ty);
+        }
+        Tile& t = *slots_[static_cast<std::size_t>(slot)];
+        t.last_use = ++clock_;
+        return t;
+    }
+
+    void load(Tile& t, unsigned tx, unsigned ty) {
+        const unsigned x0 = tx << tile_shift;
+        const unsigned y0 = ty << tile_shift;
+        const unsigned tw = std::min(paged_tile_size, w_ - x0);
+        const unsigned th = std::min(paged_tile_size, h_ - y0);
+
+        t.mask.reset();
+        if (t.pixels.width() != tw || t.pixels.height() != th)
+            t.pixels = Image(tw, th);
+        for (unsigned r = 0; r < th; ++r)
+            file_.read(x0, y0 + r, tw, &t.pixels.at(0, r));
+        t.mask.emplace(t.pixels, seed_, tolerance_, metric_);
+        t.tx    = tx;
+        t.ty    = ty;
+        t.dirty = false;
+    }
+
+    void write_back(Tile& t) {
+        const unsigned x0 = t.tx << tile_shift;
+        const unsigned y0 = t.ty << tile_shift;
+        for (unsigned r = 0; r < t.pixels.height(); ++r)
+            file_.write(x0, y0 + r, t.pixels.width(), &t.pixels.at(0, r));
+        t.dirty = false;
+    }
+
+    [[nodiscard]] std::size_t key(unsigned tx, unsigned ty) const noexcept {
+        return static_cast<std::size_t>(ty) * tiles_x_ + tx;
+    }
+
+    RawFile&    file_;
+    unsigned    w_;
+    unsigned    h_;
+    RGBA        seed_;
+    double      tolerance_;
+    ColorMetric metric_;
+    unsigned    tiles_x_;
+    std::size_t capacity_;
+    std::vector<std::int32_t>          slot_of_; // -1 when not resident
+    std::vector<std::unique_ptr<Tile>> slots_;
+    Tile*         last_  = nullptr;
+    std::uint64_t clock_ = 0;
+};
+
+/// The walks' tolerance test, answered by the resident tile.
+class PagedMask {
+public:
+    explicit PagedMask(TileCache& cache) : cache_(cache) {}
+
+    [[nodiscard]] bool test(unsigned x, unsigned y) {
+        return cache_.get(x, y).mask->test(x & tile_mask, y & tile_mask);
+    }
+
+private:
+    TileCache& cache_;
+};
+
+/// The walks' painter: colours pixels in their tiles and marks them dirty.
+/// No frames are captured.
+template <class Pick>
+class PagedPainter {
+public:
+    PagedPainter(TileCache& cache, Pick pick) : cache_(cache), pick_(pick) {}
+
+    void pixel(int x, int y) {
+        const auto ux = static_cast<unsigned>(x);
+        const auto uy = static_cast<unsigned>(y);
+        Tile& t = cache_.get(ux, uy);
+        RGBA& px = t.pixels.at(ux & tile_mask, uy & tile_mask);
+        px = pick_(Point{x, y}, px);
+        t.dirty = true;
+        TRIPLEFILL_COUNT(telemetry_.picker_calls, 1);
+        ++filled_;
+    }
+
+    /// Colour [xl, xr] of row y, a tile at a time.
+    void run(int y, int xl, int xr) {
+        const auto uy = static_cast<unsigned>(y);
+        while (xl <= xr) {
+            const auto ux = static_cast<unsigned>(xl);
+            Tile& t = cache_.get(ux, uy);
+            const int end = std::min(xr, static_cast<int>(ux | tile_mask));
+            RGBA* px = &t.pixels.at(ux & tile_mask, uy & tile_mask);
+            for (int x = xl; x <= end; ++x, ++px) *px = pick_(Point{x, y}, *px);
+            t.dirty = true;
+            const auto n = static_cast<std::size_t>(end - xl) + 1;
+            TRIPLEFILL_COUNT(telemetry_.picker_calls, n);
+            filled_ += n;
+            xl = end + 1;
+        }
+    }
+
+    [[nodiscard]] std::size_t filled() const noexcept { return filled_; }
+
+    [[nodiscard]] FillTelemetry&       telemetry()       noexcept { return telemetry_; }
+    [[nodiscard]] const FillTelemetry& telemetry() const noexcept { return telemetry_; }
+
+private:
+    TileCache&    cache_;
+    Pick          pick_;
+    std::size_t   filled_ = 0;
+    FillTelemetry telemetry_;
+};
+
+} // namespace
+
+FillStats flood_fill_file(const std::filesystem::path& input,
+                          const std::filesystem::path& output,
+                          unsigned width, unsigned height,
+                          const FillConfig& cfg,
+                          std::size_t max_resident_tiles) {
+    if (!std::filesystem::exists(output) ||
+        !std::filesystem::equivalent(input, output))
+        std::filesystem::copy_file(
+            input, output, std::filesystem::copy_options::overwrite_existing);
+
+    RawFile   file(output, width, height);
+    FillStats stats;
+    if (cfg.seed.x < 0 || cfg.seed.y < 0 ||
+        static_cast<unsigned>(cfg.seed.x) >= width ||
+        static_cast<unsigned>(cfg.seed.y) >= height)
+        return stats;
+    detail::check_frontier_range(width, height);
+
+    RGBA seed_color;
+    file.read(static_cast<unsigned>(cfg.seed.x),
+              static_cast<unsigned>(cfg.seed.y), 1, &seed_color);
+
+    VisitedMap       visited(width, height);
+    detail::Frontier frontier(width, height);
+    TileCache        cache(file, width, height, seed_color, cfg.tolerance,
+                           cfg.metric, max_resident_tiles);
+    PagedMask        mask(cache);
+    const Algorithm  algorithm = cfg.algorithm == Algorithm::Parallel
+                                     ? Algorithm::Scanline
+                                     : cfg.algorithm;
+
+    detail::visit_picker(cfg.picker, visited, width, height, [&](auto pick) {
+        PagedPainter paint(cache, pick);
+        auto walk_with = [&](auto conn) {
+            detail::visit_walk<decltype(paint), decltype(conn)::value,
+                               PagedMask>(algorithm, [&](auto walk_type) {
+                typename decltype(walk_type)::type walk(cfg, visited, frontier,
+                                                        mask, paint);
+                stats.stop = *detail::drive(
+                    walk, paint, cfg, std::numeric_limits<std::size_t>::max());
+            });
+        };
+        {
+            TRIPLEFILL_TIME_PHASE(paint.telemetry().traverse_seconds);
+            if (cfg.connectivity == Connectivity::Eight)
+                walk_with(std::integral_constant<Connectivity,
+                                                 Connectivity::Eight>{});
+            else
+                walk_with(std::integral_constant<Connectivity,
+                                                 Connectivity::Four>{});
+        }
+        stats.filled_pixels = paint.filled();
+        stats.telemetry     = paint.telemetry();
+    });
+
+    cache.flush();
+    stats.frontier_peak = frontier.peak();
+    return stats;
+}
+
+} // namespace triplefill
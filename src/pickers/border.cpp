@@ -2,17 +2,12 @@
 
 namespace triplefill {
 
-RGBA pick_border(const BorderPicker& bp,
-                 const std::vector<std::uint8_t>& visited,
-                 unsigned img_w, unsigned img_h,
+RGBA pick_border(const BorderPicker& bp, const VisitedMap& visited,
                  Point pt, const RGBA& /*original*/) {
     const int bw = static_cast<int>(bp.border_width);
-    const int w  = static_cast<int>(img_w);
-    const int h  = static_cast<int>(img_h);
 
     auto is_filled = [&](int x, int y) -> bool {
-        if (x < 0 || x >= w || y < 0 || y >= h) return false;
-        return visited[static_cast<std::size_t>(y) * img_w + x] != 0;
+        return visited.filled(x, y);
     };
 
     // Check all four cardinal directions up to border_width steps.
@@ -0,0 +1,70 @@
+#include "triplefill/prepared_image.hpp"
+#include "fill_internal.hpp"
+#include "triplefill/tolerance.hpp"
+#include "triplefill/tolerance_mask.hpp"
+
+#include <new>
+
+namespace triplefill {
+
+void PreparedImage::AlignedFree::operator()(float* p) const noexcept {
+    ::operator delete[](p, std::align_val_t{alignment});
+}
+
+PreparedImage::PreparedImage(const Image& img, unsigned threads)
+    : img_(img.layout() == Layout::RowMajor ? img
+                                            : img.converted(Layout::RowMajor)) {
+    constexpr std::size_t per_line = alignment / sizeof(float);
+    const unsigned w = img_.width();
+    const unsigned h = img_.height();
+    stride_ = (static_cast<std::size_t>(w) + per_line - 1) / per_line * per_line;
+    planes_.reset(static_cast<float*>(::operator new[](
+        3 * stride_ * h * sizeof(float), std::align_val_t{alignment})));
+
+    // Bands of rows, so workers write whole cache lines of their own
+    constexpr unsigned band = 16;
+    const std::size_t bands = (h + band - 1) / band;
+    detail::parallel_for(bands, detail::resolve_threads(threads),
+                         [&](std::size_t b) {
+        const auto y0 = static_cast<unsigned>(b * band);
+        const unsigned y1 = std::min(h, y0 + band);
+        for (unsigned y = y0; y < y1; ++y) {
+            float* hue = plane(0, y);
+            float* sat = plane(1, y);
+            float* lum = plane(2, y);
+            const RGBA* px = &img_.at(0, y);
+            // Flat areas repeat colours; convert each run once
+            float last[3] = {};
+            for (unsigned x = 0; x < w; ++x) {
+                if (x == 0 || px[x] != px[x - 1]) {
+                    const HSL c = rgb_to_hsl(px[x]);
+                    last[0] = static_cast<float>(c.h / 360.0);
+                    last[1] = static_cast<float>(c.s);
+                    last[2] = static_cast<float>(c.l);
+                }
+                hue[x] = last[0];
+                sat[x] = last[1];
+                lum[x] = last[2];
+            }
+            for (std::size_t x = w; x < stride_; ++x)
+                hue[x] = sat[x] = lum[x] = 0.0f;
+        }
+    });
+}
+
+Animation flood_fill(const PreparedImage& prepared, const FillConfig& cfg) {
+    const Image& img = prepared.image();
+    if (cfg.metric != ColorMetric::Hsl) return flood_fill(img, cfg);
+    if (!detail::seed_in_bounds(img, cfg.seed))
+        return {};
+
+    VisitedMap       visited(img.width(), img.height());
+    detail::Frontier frontier(img.width(), img.height());
+    const RGBA seed_color = img.at(static_cast<unsigned>(cfg.seed.x),
+                                   static_cast<unsigned>(cfg.seed.y));
+    ToleranceMask in_tolerance(prepared, seed_color, cfg.tolerance);
+
+    return detail::fill_into(img, cfg, visited, frontier, in_tolerance, false);
+}
+
+} // namespace triplefill
@@ -0,0 +1,110 @@
+#include "triplefill/selection.hpp"
+#include "fill_internal.hpp"
+#include "fill_kernel.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+
+namespace triplefill {
+
+bool Selection::contains(Point p) const noexcept {
+    // Last span starting at or before p on p's row
+    auto it = std::upper_bound(spans.begin(), spans.end(), p,
+                               [](Point q, const Span& s) {
+                                   return q.y < s.y ||
+                                          (q.y == s.y && q.x < s.x0);
+                               });
+    if (it == spans.begin()) return false;
+    --it;
+    return it->y == p.y && p.x <= it->x1;
+}
+
+namespace {
+
+/// Painter for ScanlineWalk that records the runs it is given as spans
+/// instead of colouring them. A run handed over in pieces becomes one span.
+class SpanRecorder {
+public:
+    explicit SpanRecorder(std::vector<Span>& spans) : spans_(spans) {}
+
+    void run(int y, int xl, int xr) {
+        if (!spans_.empty() && spans_.back().y == y &&
+            spans_.back().x1 + 1 == xl)
+            spans_.back().x1 = xr;
+        else
+            spans_.push_back({y, xl, xr});
+        filled_ += static_cast<std::size_t>(xr - xl) + 1;
+    }
+
+    [[nodiscard]] std::size_t filled() const noexcept { return filled_; }
+    [[nodiscard]] FillTelemetry& telemetry() noexcept { return telemetry_; }
+
+private:
+    std::vector<Span>& spans_;
+    std::size_t        filled_ = 0;
+    FillTelemetry      telemetry_;
+};
+
+template <Connectivity C>
+StopReason select_spans(const FillConfig& cfg, VisitedMap& visited,
+                        detail::Frontier& seeds, ToleranceMask& in_tolerance,
+                        SpanRecorder& record) {
+    detail::ScanlineWalk<C, SpanRecorder> walk(cfg, visited, seeds,
+                                               in_tolerance, record);
+    return *detail::drive(walk, record, cfg,
+                          std::numeric_limits<std::size_t>::max());
+}
+
+} // namespace
+
+Selection flood_select(const Image& img, const FillConfig& cfg,
+                       bool with_mask) {
+    Selection out;
+    if (!detail::seed_in_bounds(img, cfg.seed)) return out;
+
+    const unsigned w = img.width();
+    const unsigned h = img.height();
+    detail::check_frontier_range(w, h);
+
+    VisitedMap       visited(w, h);
+    detail::Frontier seeds(w, h);
+    ToleranceMask    in_tolerance(img,
+                                  img.at(static_cast<unsigned>(cfg.seed.x),
+                                         static_cast<unsigned>(cfg.seed.y)),
+                                  cfg.tolerance, cfg.metric);
+
+    // The Scanline walk, recording each run instead of painting it
+    SpanRecorder record(out.spans);
+    out.stop = cfg.connectivity == Connectivity::Eight
+                   ? select_spans<Connectivity::Eight>(cfg, visited, seeds,
+                                                       in_tolerance, record)
+                   : select_spans<Connectivity::Four>(cfg, visited, seeds,
+                                                      in_tolerance, record);
+    out.pixel_count = record.filled();
+
+    if (out.truncated()) {
+        // A budget smaller than the seed's run cuts it at its left end.
+        // The run is open up to the seed, so end the span there instead.
+        if (out.spans.size() == 1 && out.spans[0].x1 < cfg.seed.x) {
+            const int len = out.spans[0].x1 - out.spans[0].x0;
+            out.spans[0].x1 = cfg.seed.x;
+            out.spans[0].x0 = cfg.seed.x - len;
+        }
+        // The walk marks a run visited before painting it, so the map
+        // holds all of a cut run
+        if (with_mask) {
+            visited.reset();
+            for (const Span& s : out.spans) visited.set_run(s.y, s.x0, s.x1);
+        }
+    }
+
+    std::sort(out.spans.begin(), out.spans.end(),
+              [](const Span& a, const Span& b) {
+                  return a.y < b.y || (a.y == b.y && a.x0 < b.x0);
+              });
+    if (with_mask) out.mask = std::move(visited);
+    return out;
+}
+
+} // namespace triplefill
@@ -0,0 +1,78 @@
+#pragma once
+
+// Hooks that feed FillStats::telemetry. With TRIPLEFILL_STATS off every hook
+// expands to nothing, so release builds pay neither the counting nor the
+// clock reads.
+
+#include "triplefill/animation.hpp"
+
+#include <atomic>
+#include <chrono>
+
+namespace triplefill::detail {
+
+/// Adds `from` into `into`, field by field.
+inline void accumulate(FillTelemetry& into, const FillTelemetry& from) {
+    into.tolerance_evaluations += from.tolerance_evaluations;
+    into.memo_hits             += from.memo_hits;
+    into.neighbour_tests       += from.neighbour_tests;
+    into.rejected_neighbours   += from.rejected_neighbours;
+    into.picker_calls          += from.picker_calls;
+    into.frame_copy_bytes      += from.frame_copy_bytes;
+    into.setup_seconds         += from.setup_seconds;
+    into.traverse_seconds      += from.traverse_seconds;
+    into.paint_seconds         += from.paint_seconds;
+    into.capture_seconds       += from.capture_seconds;
+}
+
+} // namespace triplefill::detail
+
+#if defined(TRIPLEFILL_STATS) && TRIPLEFILL_STATS
+
+namespace triplefill::detail {
+
+/// Adds the lifetime of the enclosing scope to `seconds`.
+class PhaseTimer {
+public:
+    explicit PhaseTimer(double& seconds)
+        : seconds_(seconds), t0_(std::chrono::steady_clock::now()) {}
+    ~PhaseTimer() {
+        seconds_ += std::chrono::duration<double>(
+                        std::chrono::steady_clock::now() - t0_)
+                        .count();
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    double& seconds_;
+    std::chrono::steady_clock::time_point t0_;
+};
+
+} // namespace triplefill::detail
+
+#define TRIPLEFILL_COUNT(counter, n) ((counter) += (n))
+// For counters that several threads update at once.
+#define TRIPLEFILL_COUNT_SHARED(counter, n) \
+    (std::atomic_ref(counter).fetch_add((n), std::memory_order_relaxed))
+#define TRIPLEFILL_TIME_PHASE(seconds) \
+    ::triplefill::detail::PhaseTimer triplefill_phase_timer_(seconds)
+// For phases with several exits: start a named clock, then add the time
+// since it started at each exit.
+#define TRIPLEFILL_PHASE_START(clock) \
+    const auto clock = std::chrono::steady_clock::now()
+#define TRIPLEFILL_PHASE_END(seconds, clock)                                  \
+    ((seconds) += std::chrono::duration<double>(                              \
+                      std::chrono::steady_clock::now() - (clock))             \
+                      .count())
+
+#else
+
+#define TRIPLEFILL_COUNT(counter, n) ((void)0)
+#define TRIPLEFILL_COUNT_SHARED(counter, n) ((void)0)
+#define TRIPLEFILL_TIME_PHASE(seconds) ((void)0)
+#define TRIPLEFILL_PHASE_START(clock) ((void)0)
+#define TRIPLEFILL_PHASE_END(seconds, clock) ((void)0)
+
+#endif
@@ -0,0 +1,61 @@
+#include "triplefill/tile_canvas.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace triplefill {
+
+TileCanvas::TileCanvas(const Image& img)
+    : w_(img.width()),
+      h_(img.height()),
+      tiles_x_((img.width() + tile_size - 1) >> tile_shift) {
+    const unsigned tiles_y = (h_ + tile_size - 1) >> tile_shift;
+    tiles_.reserve(static_cast<std::size_t>(tiles_x_) * tiles_y);
+    for (unsigned ty = 0; ty < tiles_y; ++ty) {
+        for (unsigned tx = 0; tx < tiles_x_; ++tx) {
+            auto tile = std::make_shared<Tile>(); // edge padding stays zero
+            const unsigned x0 = tx << tile_shift, y0 = ty << tile_shift;
+            const unsigned tw = std::min(tile_size, w_ - x0);
+            const unsigned th = std::min(tile_size, h_ - y0);
+            for (unsigned y = 0; y < th; ++y)
+                std::memcpy(&tile->px[y << tile_shift], &img.at(x0, y0 + y),
+                            tw * sizeof(RGBA));
+            tiles_.push_back(std::move(tile));
+        }
+    }
+}
+
+Image TileCanvas::to_image(Layout layout) const {
+    Image out(w_, h_, layout);
+    copy_to(out);
+    return out;
+}
+
+void TileCanvas::copy_to(Image& out) const {
+    // A tile row is contiguous in either layout of `out`
+    for (std::size_t t = 0; t < tiles_.size(); ++t) {
+        const unsigned x0 = static_cast<unsigned>(t % tiles_x_) << tile_shift;
+        const unsigned y0 = static_cast<unsigned>(t / tiles_x_) << tile_shift;
+        const unsigned tw = std::min(tile_size, w_ - x0);
+        const unsigned th = std::min(tile_size, h_ - y0);
+        for (unsigned y = 0; y < th; ++y)
+            std::memcpy(&out.at(x0, y0 + y), &tiles_[t]->px[y << tile_shift],
+                        tw * sizeof(RGBA));
+    }
+}
+
+std::size_t TileCanvas::shared_tiles() const noexcept {
+    return static_cast<std::size_t>(
+        std::count_if(tiles_.begin(), tiles_.end(),
+                      [](const auto& t) { return t.use_count() > 1; }));
+}
+
+TileCanvas::Tile& TileCanvas::writable(std::size_t t) {
+    if (tiles_[t].use_count() > 1) {
+        tiles_[t] = std::make_shared<Tile>(*tiles_[t]);
+        ++copies_;
+    }
+    return *tiles_[t];
+}
+
+} // namespace triplefill
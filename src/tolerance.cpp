@@ -66,9 +66,10 @@ RGBA hsl_to_rgb(const HSL& hsl, std::uint8_t a) noexcept {
 }
 
 double color_distance(const RGBA& a, const RGBA& b) noexcept {
-    const HSL ha = rgb_to_hsl(a);
-    const HSL hb = rgb_to_hsl(b);
+    return color_distance(rgb_to_hsl(a), rgb_to_hsl(b));
+}
 
+double color_distance(const HSL& ha, const HSL& hb) noexcept {
     double dh = std::fabs(ha.h - hb.h) / 360.0;
     if (dh > 0.5) dh = 1.0 - dh; // shortest arc
 
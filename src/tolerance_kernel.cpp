@@ -0,0 +1,728 @@
+#include "triplefill/prepared_image.hpp"
+#include "triplefill/tolerance.hpp"
+
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+#include <immintrin.h>
+#define TRIPLEFILL_X86_SIMD 1
+#elif defined(__aarch64__) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define TRIPLEFILL_NEON_SIMD 1
+#elif defined(__wasm_simd128__)
+#include <wasm_simd128.h>
+#define TRIPLEFILL_WASM_SIMD 1
+#endif
+
+namespace triplefill {
+
+namespace {
+
+// ---- ISA wrappers ----------------------------------------------------------
+//
+// Each wrapper exposes the single-precision operations the metric kernels
+// need. The kernels below are written once against this interface.
+
+#if defined(TRIPLEFILL_X86_SIMD) && defined(__AVX2__)
+
+struct Avx2Ops {
+    using F = __m256;
+    using M = __m256;
+    static constexpr std::size_t lanes = 8;
+    static constexpr unsigned    all   = 0xFF;
+    static constexpr const char* name  = "avx2";
+
+    static F set(float v) { return _mm256_set1_ps(v); }
+    static F load(const float* p) { return _mm256_loadu_ps(p); }
+
+    static void load_rgba(const RGBA* p, F& r, F& g, F& b, F& a) {
+        const __m256i v =
+            _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p));
+        const __m256i m = _mm256_set1_epi32(0xFF);
+        r = _mm256_cvtepi32_ps(_mm256_and_si256(v, m));
+        g = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 8), m));
+        b = _mm256_cvtepi32_ps(_mm256_and_si256(_mm256_srli_epi32(v, 16), m));
+        a = _mm256_cvtepi32_ps(_mm256_srli_epi32(v, 24));
+    }
+
+    static F add(F a, F b) { return _mm256_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm256_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm256_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm256_div_ps(a, b); }
+    static F max(F a, F b) { return _mm256_max_ps(a, b); }
+    static F min(F a, F b) { return _mm256_min_ps(a, b); }
+    static F abs(F a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+
+    static M lt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+    static M le(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+    static M gt(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    static M eq(F a, F b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+
+    /// m ? a : b
+    static F select(M m, F a, F b) { return _mm256_blendv_ps(b, a, m); }
+    static unsigned bits(M m) {
+        return static_cast<unsigned>(_mm256_movemask_ps(m));
+    }
+};
+
+#endif
+
+#if defined(TRIPLEFILL_X86_SIMD)
+
+struct SseOps {
+    using F = __m128;
+    using M = __m128;
+    static constexpr std::size_t lanes = 4;
+    static constexpr unsigned    all   = 0xF;
+#if defined(__SSE4_1__)
+    static constexpr const char* name = "sse4.1";
+#else
+    static constexpr const char* name = "sse2";
+#endif
+
+    static F set(float v) { return _mm_set1_ps(v); }
+    static F load(const float* p) { return _mm_loadu_ps(p); }
+
+    static void load_rgba(const RGBA* p, F& r, F& g, F& b, F& a) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        const __m128i m = _mm_set1_epi32(0xFF);
+        r = _mm_cvtepi32_ps(_mm_and_si128(v, m));
+        g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 8), m));
+        b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 16), m));
+        a = _mm_cvtepi32_ps(_mm_srli_epi32(v, 24));
+    }
+
+    static F add(F a, F b) { return _mm_add_ps(a, b); }
+    static F sub(F a, F b) { return _mm_sub_ps(a, b); }
+    static F mul(F a, F b) { return _mm_mul_ps(a, b); }
+    static F div(F a, F b) { return _mm_div_ps(a, b); }
+    static F max(F a, F b) { return _mm_max_ps(a, b); }
+    static F min(F a, F b) { return _mm_min_ps(a, b); }
+    static F abs(F a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+
+    static M lt(F a, F b) { return _mm_cmplt_ps(a, b); }
+    static M le(F a, F b) { return _mm_cmple_ps(a, b); }
+    static M gt(F a, F b) { return _mm_cmpgt_ps(a, b); }
+    static M eq(F a, F b) { return _mm_cmpeq_ps(a, b); }
+
+    static F select(M m, F a, F b) {
+#if defined(__SSE4_1__)
+        return _mm_blendv_ps(b, a, m);
+#else
+        return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b));
+#endif
+    }
+    static unsigned bits(M m) {
+        return static_cast<unsigned>(_mm_movemask_ps(m));
+    }
+};
+
+#endif
+
+#if defined(TRIPLEFILL_NEON_SIMD)
+
+struct NeonOps {
+    using F = float32x4_t;
+    using M = uint32x4_t;
+    static constexpr std::size_t lanes = 4;
+    static constexpr unsigned    all   = 0xF;
+    static constexpr const char* name  = "neon";
+
+    static F set(float v) { return vdupq_n_f32(v); }
+    static F load(const float* p) { return vld1q_f32(p); }
+
+    static void load_rgba(const RGBA* p, F& r, F& g, F& b, F& a) {
+        std::uint32_t raw[4];
+        std::memcpy(raw, p, sizeof(raw));
+        const uint32x4_t v = vld1q_u32(raw);
+        const uint32x4_t m = vdupq_n_u32(0xFF);
+        r = vcvtq_f32_u32(vandq_u32(v, m));
+        g = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(v, 8), m));
+        b = vcvtq_f32_u32(vandq_u32(vshrq_n_u32(v, 16), m));
+        a = vcvtq_f32_u32(vshrq_n_u32(v, 24));
+    }
+
+    static F add(F a, F b) { return vaddq_f32(a, b); }
+    static F sub(F a, F b) { return vsubq_f32(a, b); }
+    static F mul(F a, F b) { return vmulq_f32(a, b); }
+    static F div(F a, F b) { return vdivq_f32(a, b); }
+    static F max(F a, F b) { return vmaxq_f32(a, b); }
+    static F min(F a, F b) { return vminq_f32(a, b); }
+    static F abs(F a) { return vabsq_f32(a); }
+
+    static M lt(F a, F b) { return vcltq_f32(a, b); }
+    static M le(F a, F b) { return vcleq_f32(a, b); }
+    static M gt(F a, F b) { return vcgtq_f32(a, b); }
+    static M eq(F a, F b) { return vceqq_f32(a, b); }
+
+    static F select(M m, F a, F b) { return vbslq_f32(m, a, b); }
+    static unsigned bits(M m) {
+        const uint32x4_t weight = {1, 2, 4, 8};
+        return vaddvq_u32(vandq_u32(m, weight));
+    }
+};
+
+#endif
+
+#if defined(TRIPLEFILL_WASM_SIMD)
+
+struct WasmOps {
+    using F = v128_t;
+    using M = v128_t;
+    static constexpr std::size_t lanes = 4;
+    static constexpr unsigned    all   = 0xF;
+    static constexpr const char* name  = "simd128";
+
+    static F set(float v) { return wasm_f32x4_splat(v); }
+    static F load(const float* p) { return wasm_v128_load(p); }
+
+    static void load_rgba(const RGBA* p, F& r, F& g, F& b, F& a) {
+        const v128_t v = wasm_v128_load(p);
+        const v128_t m = wasm_i32x4_splat(0xFF);
+        r = wasm_f32x4_convert_i32x4(wasm_v128_and(v, m));
+        g = wasm_f32x4_convert_i32x4(wasm_v128_and(wasm_u32x4_shr(v, 8), m));
+        b = wasm_f32x4_convert_i32x4(wasm_v128_and(wasm_u32x4_shr(v, 16), m));
+        a = wasm_f32x4_convert_i32x4(wasm_u32x4_shr(v, 24));
+    }
+
+    static F add(F a, F b) { return wasm_f32x4_add(a, b); }
+    static F sub(F a, F b) { return wasm_f32x4_sub(a, b); }
+    static F mul(F a, F b) { return wasm_f32x4_mul(a, b); }
+    static F div(F a, F b) { return wasm_f32x4_div(a, b); }
+    static F max(F a, F b) { return wasm_f32x4_max(a, b); }
+    static F min(F a, F b) { return wasm_f32x4_min(a, b); }
+    static F abs(F a) { return wasm_f32x4_abs(a); }
+
+    static M lt(F a, F b) { return wasm_f32x4_lt(a, b); }
+    static M le(F a, F b) { return wasm_f32x4_le(a, b); }
+    static M gt(F a, F b) { return wasm_f32x4_gt(a, b); }
+    static M eq(F a, F b) { return wasm_f32x4_eq(a, b); }
+
+    static F select(M m, F a, F b) { return wasm_v128_bitselect(a, b, m); }
+    static unsigned bits(M m) {
+        return static_cast<unsigned>(wasm_i32x4_bitmask(m));
+    }
+};
+
+#endif
+
+#if defined(TRIPLEFILL_X86_SIMD) && defined(__AVX2__)
+using KernelOps = Avx2Ops;
+#elif defined(TRIPLEFILL_X86_SIMD)
+using KernelOps = SseOps;
+#elif defined(TRIPLEFILL_NEON_SIMD)
+using KernelOps = NeonOps;
+#elif defined(TRIPLEFILL_WASM_SIMD)
+using KernelOps = WasmOps;
+#else
+#define TRIPLEFILL_SCALAR_ONLY 1
+#endif
+
+// ---- metrics ---------------------------------------------------------------
+//
+// Each metric is a policy:
+//   Reference   - the metric's definition in double precision, built from
+//                 the seed; color_distance(a, b, metric) calls it.
+//   Lanes<V>    - the SIMD side, built from the seed and tolerance. key()
+//                 computes a per-lane key that rises with the distance, or
+//                 returns false when every lane is certainly out; a lane is
+//                 certainly in when key <= lo, and is re-tested with the
+//                 Reference when lo < key <= hi.
+//   vectorised  - false for metrics with no Lanes (the scalar loop runs).
+//   memoised    - verdicts depend on RGB only and cost more than a lookup
+//                 in ToleranceMask's colour table.
+//
+// Metrics over integer keys (sums of squared channel differences, largest
+// channel difference) find the largest key whose Reference distance is
+// within tolerance once per call, then compare keys exactly: lo == hi.
+
+/// Largest k in [0, max] with ok(k), or -1; ok must be true up to some k
+/// and false after it.
+template <class Ok>
+std::int64_t last_within(std::int64_t max, Ok ok) {
+    std::int64_t lo = -1, hi = max + 1;
+    while (hi - lo > 1) {
+        const std::int64_t mid = lo + (hi - lo) / 2;
+        (ok(mid) ? lo : hi) = mid;
+    }
+    return lo;
+}
+
+int max_channel(const RGBA& c) { return std::max({c.r, c.g, c.b}); }
+int min_channel(const RGBA& c) { return std::min({c.r, c.g, c.b}); }
+
+struct HslMetric {
+    static constexpr bool vectorised = true;
+    static constexpr bool memoised   = true;
+
+    struct Reference {
+        HSL seed;
+        explicit Reference(const RGBA& s) : seed(rgb_to_hsl(s)) {}
+        double operator()(const RGBA& c) const {
+            return color_distance(seed, rgb_to_hsl(c));
+        }
+    };
+
+    /// Squared HSL distance in single precision, from integer channel
+    /// values.
+    ///
+    /// On 8-bit channels the branches of rgb_to_hsl are integer facts: a
+    /// pixel is achromatic exactly when max == min (one step is 1/255, far
+    /// above the 1e-4 cut-offs), and the hue sector is picked by comparing
+    /// channels. What is left is one division each for saturation and hue:
+    ///
+    ///   s    = chroma / min(max + min, 510 - max - min)
+    ///   h/60 = (numerator / chroma + sector), + 6 if negative
+    ///
+    /// Each lane's squared distance is within 1.5e-6 of the exact value (a
+    /// few float roundings on terms no larger than 1), while color_distance
+    /// is within 1e-15. Lanes more than `band` = 1e-5 from tolerance²
+    /// therefore get the double verdict. A block whose lightness difference
+    /// alone puts every lane out skips the divisions.
+    template <class V>
+    struct Lanes {
+        using F = typename V::F;
+        using M = typename V::M;
+        static constexpr double band = 1e-5;
+
+        F lo, hi, ssum, ss, sh;
+
+        Lanes(const RGBA& seed, double tol) {
+            // Seed terms from the same formulas as the lanes
+            const int smx = max_channel(seed);
+            const int smn = min_channel(seed);
+            const int sc  = smx - smn;
+            float seed_s = 0, seed_h6 = 0;
+            if (sc != 0) {
+                const int sum = smx + smn;
+                const auto fc = static_cast<float>(sc);
+                seed_s = fc / static_cast<float>(std::min(sum, 510 - sum));
+                if (smx == seed.r)
+                    seed_h6 = static_cast<float>(seed.g - seed.b) / fc;
+                else if (smx == seed.g)
+                    seed_h6 = static_cast<float>(seed.b - seed.r) / fc + 2.0f;
+                else
+                    seed_h6 = static_cast<float>(seed.r - seed.g) / fc + 4.0f;
+                if (seed_h6 < 0) seed_h6 += 6.0f;
+            }
+            const double tol2 = tol * tol;
+            lo   = V::set(static_cast<float>(tol2 - band));
+            hi   = V::set(static_cast<float>(tol2 + band));
+            ssum = V::set(static_cast<float>(smx + smn));
+            ss   = V::set(seed_s);
+            sh   = V::set(seed_h6);
+        }
+
+        bool key(F r, F g, F b, F, F& d2) const {
+            const F zero = V::set(0.0f);
+            const F mx   = V::max(V::max(r, g), b);
+            const F mn   = V::min(V::min(r, g), b);
+            const F sum  = V::add(mx, mn);
+            const F dl   = V::mul(V::sub(ssum, sum), V::set(1.0f / 510.0f));
+            const F dl2  = V::mul(dl, dl);
+            if (V::bits(V::gt(dl2, hi)) == V::all) return false;
+
+            const F chroma = V::sub(mx, mn);
+            const M achrom = V::eq(chroma, zero);
+
+            F s = V::div(chroma, V::min(sum, V::sub(V::set(510.0f), sum)));
+            const M is_r = V::eq(mx, r);
+            const M is_g = V::eq(mx, g);
+            const F num  = V::select(is_r, V::sub(g, b),
+                                     V::select(is_g, V::sub(b, r),
+                                               V::sub(r, g)));
+            const F sector = V::select(is_r, zero,
+                                       V::select(is_g, V::set(2.0f),
+                                                 V::set(4.0f)));
+            F h = V::add(V::div(num, chroma), sector);
+            h = V::select(V::lt(h, zero), V::add(h, V::set(6.0f)), h);
+
+            h = V::select(achrom, zero, h);
+            s = V::select(achrom, zero, s);
+
+            F dh = V::mul(V::abs(V::sub(sh, h)), V::set(1.0f / 6.0f));
+            dh = V::select(V::gt(dh, V::set(0.5f)),
+                           V::sub(V::set(1.0f), dh), dh);
+            const F ds = V::sub(ss, s);
+            d2 = V::add(V::add(V::mul(dh, dh), V::mul(ds, ds)), dl2);
+            return true;
+        }
+    };
+};
+
+/// Euclidean distance over R, G and B, each scaled to [0, 1]. Range
+/// [0, sqrt(3)]. Key: the integer sum of squared channel differences,
+/// exact in float.
+struct RgbMetric {
+    static constexpr bool vectorised = true;
+    static constexpr bool memoised   = false;
+
+    static int key_of(const RGBA& a, const RGBA& b) {
+        const int dr = a.r - b.r, dg = a.g - b.g, db = a.b - b.b;
+        return dr * dr + dg * dg + db * db;
+    }
+    static double distance(std::int64_t key) {
+        return std::sqrt(static_cast<double>(key)) / 255.0;
+    }
+
+    struct Reference {
+        RGBA seed;
+        explicit Reference(const RGBA& s) : seed(s) {}
+        double operator()(const RGBA& c) const {
+            return distance(key_of(seed, c));
+        }
+    };
+
+    template <class V>
+    struct Lanes {
+        using F = typename V::F;
+        F lo, hi, sr, sg, sb;
+
+        Lanes(const RGBA& seed, double tol) {
+            const auto limit = static_cast<float>(last_within(
+                3 * 255 * 255,
+                [&](std::int64_t k) { return distance(k) <= tol; }));
+            lo = hi = V::set(limit);
+            sr = V::set(seed.r);
+            sg = V::set(seed.g);
+            sb = V::set(seed.b);
+        }
+
+        bool key(F r, F g, F b, F, F& k) const {
+            const F dr = V::sub(r, sr), dg = V::sub(g, sg), db = V::sub(b, sb);
+            k = V::add(V::add(V::mul(dr, dr), V::mul(dg, dg)), V::mul(db, db));
+            return true;
+        }
+    };
+};
+
+/// Largest channel difference over R, G and B, scaled to [0, 1]. Key: that
+/// difference in 8-bit steps.
+struct MaxChannelMetric {
+    static constexpr bool vectorised = true;
+    static constexpr bool memoised   = false;
+
+    static double distance(std::int64_t key) {
+        return static_cast<double>(key) / 255.0;
+    }
+
+    struct Reference {
+        RGBA seed;
+        explicit Reference(const RGBA& s) : seed(s) {}
+        double operator()(const RGBA& c) const {
+            return distance(std::max({std::abs(seed.r - c.r),
+                                      std::abs(seed.g - c.g),
+                                      std::abs(seed.b - c.b)}));
+        }
+    };
+
+    template <class V>
+    struct Lanes {
+        using F = typename V::F;
+        F lo, hi, sr, sg, sb;
+
+        Lanes(const RGBA& seed, double tol) {
+            const auto limit = static_cast<float>(last_within(
+                255, [&](std::int64_t k) { return distance(k) <= tol; }));
+            lo = hi = V::set(limit);
+            sr = V::set(seed.r);
+            sg = V::set(seed.g);
+            sb = V::set(seed.b);
+        }
+
+        bool key(F r, F g, F b, F, F& k) const {
+            k = V::max(V::max(V::abs(V::sub(r, sr)), V::abs(V::sub(g, sg))),
+                       V::abs(V::sub(b, sb)));
+            return true;
+        }
+    };
+};
+
+/// The original RGBAPixel::distanceTo: channels premultiplied by alpha, and
+/// each channel's squared difference taken as the larger of the colour
+/// difference and the colour difference less the alpha difference, so a
+/// colour fading to transparent stays distinct. Like the original it is
+/// not square-rooted; range [0, 12].
+///
+/// With P = channel * alpha and A = alpha difference * 255, everything is
+/// an integer in units of 1/65025: key = sum of max(dP², (dP - A)²), and
+/// the distance is key / 65025². Keys reach 5e10, beyond float's exact
+/// range, so lanes carry a relative error below 3e-7 and a band of 1e-6
+/// around the integer limit goes to the Reference.
+struct PremultipliedRgbMetric {
+    static constexpr bool vectorised = true;
+    static constexpr bool memoised   = false;
+
+    static constexpr double unit = 65025.0;
+
+    static std::int64_t key_of(const RGBA& s, const RGBA& c) {
+        const std::int64_t da = (c.a - s.a) * 255;
+        auto term = [&](int cs, int cc) {
+            const std::int64_t dp = cc * c.a - cs * s.a;
+            return std::max(dp * dp, (dp - da) * (dp - da));
+        };
+        return term(s.r, c.r) + term(s.g, c.g) + term(s.b, c.b);
+    }
+    static double distance(std::int64_t key) {
+        return static_cast<double>(key) / (unit * unit);
+    }
+
+    struct Reference {
+        RGBA seed;
+        explicit Reference(const RGBA& s) : seed(s) {}
+        double operator()(const RGBA& c) const {
+            return distance(key_of(seed, c));
+        }
+    };
+
+    template <class V>
+    struct Lanes {
+        using F = typename V::F;
+        F lo, hi, pr, pg, pb, sa;
+
+        Lanes(const RGBA& seed, double tol) {
+            const auto limit = static_cast<double>(last_within(
+                std::int64_t{12} * 65025 * 65025,
+                [&](std::int64_t k) { return distance(k) <= tol; }));
+            lo = V::set(static_cast<float>(limit * (1 - 1e-6) - 1));
+            hi = V::set(static_cast<float>(limit * (1 + 1e-6) + 1));
+            pr = V::set(static_cast<float>(seed.r * seed.a));
+            pg = V::set(static_cast<float>(seed.g * seed.a));
+            pb = V::set(static_cast<float>(seed.b * seed.a));
+            sa = V::set(seed.a);
+        }
+
+        bool key(F r, F g, F b, F a, F& k) const {
+            const F da = V::mul(V::sub(a, sa), V::set(255.0f));
+            auto term = [&](F c, F ps) {
+                const F dp = V::sub(V::mul(c, a), ps);
+                const F dq = V::sub(dp, da);
+                return V::max(V::mul(dp, dp), V::mul(dq, dq));
+            };
+            k = V::add(V::add(term(r, pr), term(g, pg)), term(b, pb));
+            return true;
+        }
+    };
+};
+
+/// CIE76 ΔE: Euclidean distance in CIELAB (D65 white, sRGB primaries).
+/// Range about [0, 260]; 2.3 is a just-noticeable difference. The cube
+/// roots make a SIMD kernel a poor trade; verdicts are memoised per colour
+/// instead, so each distinct colour is converted once per seed.
+struct LabMetric {
+    static constexpr bool vectorised = false;
+    static constexpr bool memoised   = true;
+
+    struct Lab { double l, a, b; };
+
+    static double linear(std::uint8_t c) {
+        static const auto table = [] {
+            std::array<double, 256> t{};
+            for (int i = 0; i < 256; ++i) {
+                const double v = i / 255.0;
+                t[static_cast<std::size_t>(i)] =
+                    v <= 0.04045 ? v / 12.92
+                                 : std::pow((v + 0.055) / 1.055, 2.4);
+            }
+            return t;
+        }();
+        return table[c];
+    }
+
+    static Lab to_lab(const RGBA& c) {
+        const double r = linear(c.r), g = linear(c.g), b = linear(c.b);
+        const double x = (0.4124564 * r + 0.3575761 * g + 0.1804375 * b) / 0.95047;
+        const double y =  0.2126729 * r + 0.7151522 * g + 0.0721750 * b;
+        const double z = (0.0193339 * r + 0.1191920 * g + 0.9503041 * b) / 1.08883;
+        auto f = [](double t) {
+            constexpr double d = 6.0 / 29.0;
+            return t > d * d * d ? std::cbrt(t) : t / (3 * d * d) + 4.0 / 29.0;
+        };
+        const double fx = f(x), fy = f(y), fz = f(z);
+        return {116 * fy - 16, 500 * (fx - fy), 200 * (fy - fz)};
+    }
+
+    struct Reference {
+        Lab seed;
+        explicit Reference(const RGBA& s) : seed(to_lab(s)) {}
+        double operator()(const RGBA& c) const {
+            const Lab p = to_lab(c);
+            const double dl = p.l - seed.l, da = p.a - seed.a,
+                         db = p.b - seed.b;
+            return std::sqrt(dl * dl + da * da + db * db);
+        }
+    };
+};
+
+/// Call fn with the policy for `metric`.
+template <class Fn>
+decltype(auto) visit_metric(ColorMetric metric, Fn&& fn) {
+    switch (metric) {
+    case ColorMetric::Rgb:              return fn(RgbMetric{});
+    case ColorMetric::MaxChannel:       return fn(MaxChannelMetric{});
+    case ColorMetric::PremultipliedRgb: return fn(PremultipliedRgbMetric{});
+    case ColorMetric::Lab:              return fn(LabMetric{});
+    case ColorMetric::Hsl:              break;
+    }
+    return fn(HslMetric{});
+}
+
+// ---- kernels ---------------------------------------------------------------
+
+template <class Ref>
+void within_scalar(const RGBA* px, std::size_t begin, std::size_t end,
+                   const Ref& ref, double tol, std::uint64_t* out) {
+    for (std::size_t i = begin; i < end; ++i) {
+        if (ref(px[i]) <= tol)
+            out[i >> 6] |= std::uint64_t{1} << (i & 63);
+    }
+}
+
+#if !defined(TRIPLEFILL_SCALAR_ONLY)
+
+template <class V, class Metric>
+void within_simd(const RGBA* px, std::size_t n, const RGBA& seed,
+                 double tol, std::uint64_t* out) {
+    using F = typename V::F;
+    constexpr std::size_t L = V::lanes;
+
+    const typename Metric::Reference ref(seed);
+    const typename Metric::template Lanes<V> lanes(seed, tol);
+
+    std::size_t i = 0;
+    for (; i + L <= n; i += L) {
+        F r, g, b, a, k;
+        V::load_rgba(px + i, r, g, b, a);
+        if (!lanes.key(r, g, b, a, k)) continue;
+
+        const unsigned in = V::bits(V::le(k, lanes.lo));
+        out[i >> 6] |= std::uint64_t{in} << (i & 63);
+        for (unsigned near = V::bits(V::le(k, lanes.hi)) & ~in; near;
+             near &= near - 1) {
+            const std::size_t j =
+                i + static_cast<unsigned>(std::countr_zero(near));
+            within_scalar(px, j, j + 1, ref, tol, out);
+        }
+    }
+
+    within_scalar(px, i, n, ref, tol, out);
+}
+
+/// HSL verdicts from PreparedImage's float planes. The planes hold the
+/// double conversion rounded to float, so each lane's squared distance is
+/// within about 1e-6 of the exact one, and the same 1e-5 band as
+/// HslMetric's kernel goes to the Reference.
+template <class V>
+void within_planes(const float* hue, const float* sat, const float* lum,
+                   const RGBA* px, std::size_t n, const RGBA& seed,
+                   double tol, std::uint64_t* out) {
+    using F = typename V::F;
+    constexpr std::size_t L = V::lanes;
+    constexpr double band = HslMetric::Lanes<V>::band;
+
+    const HslMetric::Reference ref(seed);
+    const double tol2 = tol * tol;
+    const F lo = V::set(static_cast<float>(tol2 - band));
+    const F hi = V::set(static_cast<float>(tol2 + band));
+    const F sh = V::set(static_cast<float>(ref.seed.h / 360.0));
+    const F ss = V::set(static_cast<float>(ref.seed.s));
+    const F sl = V::set(static_cast<float>(ref.seed.l));
+    const F half = V::set(0.5f), one = V::set(1.0f);
+
+    std::size_t i = 0;
+    for (; i + L <= n; i += L) {
+        F dh = V::abs(V::sub(sh, V::load(hue + i)));
+        dh = V::select(V::gt(dh, half), V::sub(one, dh), dh);
+        const F ds = V::sub(ss, V::load(sat + i));
+        const F dl = V::sub(sl, V::load(lum + i));
+        const F d2 =
+            V::add(V::add(V::mul(dh, dh), V::mul(ds, ds)), V::mul(dl, dl));
+
+        const unsigned in = V::bits(V::le(d2, lo));
+        out[i >> 6] |= std::uint64_t{in} << (i & 63);
+        for (unsigned near = V::bits(V::le(d2, hi)) & ~in; near;
+             near &= near - 1) {
+            const std::size_t j =
+                i + static_cast<unsigned>(std::countr_zero(near));
+            within_scalar(px, j, j + 1, ref, tol, out);
+        }
+    }
+
+    within_scalar(px, i, n, ref, tol, out);
+}
+
+#endif
+
+} // namespace
+
+void PreparedImage::within(unsigned x, unsigned y, std::size_t n,
+                           const RGBA& seed, double tolerance,
+                           std::uint64_t* out) const noexcept {
+    if (!(tolerance >= 0)) return;
+    const RGBA* px = &img_.at(x, y);
+#if defined(TRIPLEFILL_SCALAR_ONLY)
+    const HslMetric::Reference ref(seed);
+    const double tol2 = tolerance * tolerance;
+    const float* h = hue(y) + x;
+    const float* s = saturation(y) + x;
+    const float* l = lightness(y) + x;
+    for (std::size_t i = 0; i < n; ++i) {
+        double dh = std::fabs(ref.seed.h / 360.0 - h[i]);
+        if (dh > 0.5) dh = 1.0 - dh;
+        const double ds = ref.seed.s - s[i];
+        const double dl = ref.seed.l - l[i];
+        const double d2 = dh * dh + ds * ds + dl * dl;
+        if (d2 <= tol2 - 1e-5)
+            out[i >> 6] |= std::uint64_t{1} << (i & 63);
+        else if (d2 <= tol2 + 1e-5)
+            within_scalar(px, i, i + 1, ref, tolerance, out);
+    }
+#else
+    within_planes<KernelOps>(hue(y) + x, saturation(y) + x, lightness(y) + x,
+                             px, n, seed, tolerance, out);
+#endif
+}
+
+double color_distance(const RGBA& a, const RGBA& b,
+                      ColorMetric metric) noexcept {
+    return visit_metric(metric, [&](auto m) {
+        return typename decltype(m)::Reference(a)(b);
+    });
+}
+
+void color_within(const RGBA* px, std::size_t n, const RGBA& seed,
+                  double tolerance, std::uint64_t* out,
+                  ColorMetric metric) noexcept {
+    // Distances are never below 0 (nor NaN)
+    if (!(tolerance >= 0)) return;
+    visit_metric(metric, [&](auto m) {
+        using Metric = decltype(m);
+#if !defined(TRIPLEFILL_SCALAR_ONLY)
+        if constexpr (Metric::vectorised) {
+            within_simd<KernelOps, Metric>(px, n, seed, tolerance, out);
+            return;
+        }
+#endif
+        within_scalar(px, 0, n, typename Metric::Reference(seed), tolerance,
+                      out);
+    });
+}
+
+bool color_metric_memoised(ColorMetric metric) noexcept {
+    return visit_metric(metric, [](auto m) { return decltype(m)::memoised; });
+}
+
+const char* color_within_kernel() noexcept {
+#if defined(TRIPLEFILL_SCALAR_ONLY)
+    return "scalar";
+#else
+    return KernelOps::name;
+#endif
+}
+
+} // namespace triplefill
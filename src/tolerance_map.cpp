@@ -0,0 +1,156 @@
+#include "triplefill/tolerance_map.hpp"
+#include "fill_internal.hpp"
+#include "fill_kernel.hpp"
+#include "triplefill/tolerance.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace triplefill {
+
+namespace {
+
+constexpr unsigned max_level = ToleranceMap::max_level;
+
+/// Smallest level whose tolerance covers distance d. Exact: level_of(d) <= L
+/// if and only if d <= tolerance_of(L).
+unsigned level_of(double d) noexcept {
+    if (!(d > 0)) return 0;
+    auto level = static_cast<unsigned>(
+        std::min(std::ceil(d / ToleranceMap::step), double{max_level}));
+    while (level > 0 && d <= ToleranceMap::tolerance_of(level - 1)) --level;
+    while (level < max_level && d > ToleranceMap::tolerance_of(level)) ++level;
+    return level;
+}
+
+/// Bucket-queue (Dijkstra over the 65536 levels) flood. A pixel pushed
+/// while level k is being drained gets max(k, its own level); buckets
+/// drain in increasing order, so the first push is already the smallest
+/// and pixels are marked visited on push, as in the fill walks.
+template <Connectivity C>
+void flood_levels(const Image& img, Point seed, std::uint16_t* levels) {
+    const unsigned w = img.width();
+    const unsigned h = img.height();
+    VisitedMap visited(w, h);
+    const auto stride = static_cast<std::uint32_t>(visited.stride());
+    const HSL  seed_hsl = rgb_to_hsl(
+        img.at(static_cast<unsigned>(seed.x), static_cast<unsigned>(seed.y)));
+
+    std::vector<std::vector<std::uint32_t>> buckets(max_level + 1);
+    unsigned current = 0;
+
+    // Flat areas repeat colours; remember the last conversion.
+    RGBA     last_color = img.at(static_cast<unsigned>(seed.x),
+                                 static_cast<unsigned>(seed.y));
+    unsigned last_level = 0;
+
+    auto push = [&](std::uint32_t i, int x, int y) {
+        if (visited.test(i)) return;
+        visited.set(i);
+        const RGBA& c = img.at(static_cast<unsigned>(x),
+                               static_cast<unsigned>(y));
+        if (c != last_color) {
+            last_color = c;
+            last_level = level_of(color_distance(seed_hsl, rgb_to_hsl(c)));
+        }
+        const unsigned level = std::max(current, last_level);
+        levels[static_cast<std::size_t>(y) * w + static_cast<unsigned>(x)] =
+            static_cast<std::uint16_t>(level);
+        buckets[level].push_back(i);
+    };
+
+    push(static_cast<std::uint32_t>(visited.index(seed.x, seed.y)), seed.x,
+         seed.y);
+    for (;;) {
+        auto* bucket = &buckets[current];
+        while (bucket->empty()) {
+            std::vector<std::uint32_t>().swap(*bucket);
+            if (++current > max_level) return;
+            bucket = &buckets[current];
+        }
+        const std::uint32_t cur = bucket->back();
+        bucket->pop_back();
+
+        const auto row = cur / stride;
+        const int  y   = static_cast<int>(row) - 1;
+        const int  x   = static_cast<int>(cur - row * stride) - 1;
+        detail::Neighbours<C>::expand(cur, x, y, stride, push);
+    }
+}
+
+} // namespace
+
+int ToleranceMap::level_for(double tolerance) noexcept {
+    if (!(tolerance >= 0)) return -1;
+    if (tolerance >= tolerance_of(max_level)) return max_level;
+    auto level = static_cast<int>(std::floor(tolerance / step));
+    while (level > 0 && tolerance_of(static_cast<unsigned>(level)) > tolerance)
+        --level;
+    while (level < static_cast<int>(max_level) &&
+           tolerance_of(static_cast<unsigned>(level) + 1) <= tolerance)
+        ++level;
+    return level;
+}
+
+std::size_t ToleranceMap::count(double tolerance) const noexcept {
+    const int level = level_for(tolerance);
+    if (level < 0) return empty() ? 0 : 1; // the seed is always filled
+    const auto limit = static_cast<std::uint16_t>(level);
+    std::size_t n = 0;
+    for (const std::uint16_t l : levels_) n += l <= limit;
+    return n;
+}
+
+VisitedMap ToleranceMap::region(double tolerance) const {
+    VisitedMap out(w_, h_);
+    const int level = level_for(tolerance);
+    if (level < 0) {
+        if (!empty()) out.set(seed_.x, seed_.y);
+        return out;
+    }
+    const auto limit = static_cast<std::uint16_t>(level);
+    for (unsigned y = 0; y < h_; ++y) {
+        const std::uint16_t* row = levels_.data() + static_cast<std::size_t>(y) * w_;
+        for (unsigned x = 0; x < w_;) {
+            if (row[x] > limit) {
+                ++x;
+                continue;
+            }
+            const unsigned x0 = x;
+            while (x < w_ && row[x] <= limit) ++x;
+            out.set_run(static_cast<int>(y), static_cast<int>(x0),
+                        static_cast<int>(x) - 1);
+        }
+    }
+    return out;
+}
+
+Animation ToleranceMap::fill(const Image& img, const FillConfig& cfg) const {
+    if (empty()) return {};
+    if (img.width() != w_ || img.height() != h_)
+        throw std::runtime_error("Image does not match the tolerance map");
+    if (cfg.metric != ColorMetric::Hsl)
+        throw std::runtime_error("Tolerance maps measure HSL distance");
+    return detail::paint_region(img, cfg, region(cfg.tolerance),
+                                count(cfg.tolerance));
+}
+
+ToleranceMap tolerance_map(const Image& img, Point seed,
+                           Connectivity connectivity) {
+    ToleranceMap map;
+    if (!detail::seed_in_bounds(img, seed)) return map;
+    detail::check_frontier_range(img.width(), img.height());
+
+    map.w_    = img.width();
+    map.h_    = img.height();
+    map.seed_ = seed;
+    map.levels_.assign(img.pixel_count(), max_level);
+    if (connectivity == Connectivity::Eight)
+        flood_levels<Connectivity::Eight>(img, seed, map.levels_.data());
+    else
+        flood_levels<Connectivity::Four>(img, seed, map.levels_.data());
+    return map;
+}
+
+} // namespace triplefill
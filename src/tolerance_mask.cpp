@@ -0,0 +1,217 @@
+#include "triplefill/tolerance_mask.hpp"
+#include "telemetry.hpp"
+#include "triplefill/prepared_image.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+namespace triplefill {
+
+namespace detail {
+
+std::atomic<std::size_t> verdict_tables{0};
+
+/// Verdict of `color_distance(seed, c) <= tolerance` for each 24-bit RGB
+/// colour, 2 bits each (4 MB, allocated on the first verdict): 0 unknown,
+/// 1 in, 2 out. Entries only go from unknown to a verdict every writer
+/// agrees on, so concurrent fills share a table through relaxed atomic ORs.
+class VerdictTable {
+public:
+    static constexpr unsigned unknown = 0, in = 1, out = 2;
+
+    VerdictTable() = default;
+    ~VerdictTable() {
+        if (const std::uint64_t* w = words_.load(std::memory_order_relaxed)) {
+            delete[] w;
+            verdict_tables.fetch_sub(1, std::memory_order_relaxed);
+        }
+    }
+
+    [[nodiscard]] unsigned get(std::uint32_t rgb) const noexcept {
+        std::uint64_t* words = words_.load(std::memory_order_acquire);
+        if (!words) return unknown;
+        const std::uint64_t w = std::atomic_ref(words[rgb >> 5])
+                                    .load(std::memory_order_relaxed);
+        return static_cast<unsigned>(w >> ((rgb & 31) * 2)) & 3u;
+    }
+
+    void put(std::uint32_t rgb, bool inside) {
+        std::uint64_t* words = words_.load(std::memory_order_acquire);
+        if (!words) {
+            std::call_once(allocated_, [&] {
+                words_.store(new std::uint64_t[table_words](),
+                             std::memory_order_release);
+                verdict_tables.fetch_add(1, std::memory_order_relaxed);
+            });
+            words = words_.load(std::memory_order_acquire);
+        }
+        std::atomic_ref(words[rgb >> 5])
+            .fetch_or(std::uint64_t{inside ? in : out} << ((rgb & 31) * 2),
+                      std::memory_order_relaxed);
+    }
+
+private:
+    static constexpr std::size_t table_words = (std::size_t{1} << 24) / 32;
+    std::once_flag               allocated_;
+    std::atomic<std::uint64_t*>  words_{nullptr};
+};
+
+} // namespace detail
+
+namespace {
+
+using detail::VerdictTable;
+
+std::uint32_t rgb_key(const RGBA& c) noexcept {
+    return static_cast<std::uint32_t>(c.r) |
+           static_cast<std::uint32_t>(c.g) << 8 |
+           static_cast<std::uint32_t>(c.b) << 16;
+}
+
+/// The table of the live masks with this (seed colour, tolerance, metric),
+/// so concurrent and batched fills (which keep their masks) share
+/// verdicts. Entries go once no mask holds their table.
+std::shared_ptr<VerdictTable> shared_table(const RGBA& seed, double tolerance,
+                                           ColorMetric metric) {
+    struct Slot {
+        std::uint32_t seed;
+        double        tolerance;
+        ColorMetric   metric;
+        std::weak_ptr<VerdictTable> table;
+    };
+    static std::mutex        mu;
+    static std::vector<Slot> slots;
+
+    const std::uint32_t key = rgb_key(seed);
+    std::lock_guard lock(mu);
+    std::erase_if(slots, [](const Slot& s) { return s.table.expired(); });
+    for (const Slot& s : slots) {
+        if (s.seed == key && s.tolerance == tolerance && s.metric == metric)
+            if (auto table = s.table.lock()) return table;
+    }
+    auto table = std::make_shared<VerdictTable>();
+    slots.push_back({key, tolerance, metric, table});
+    return table;
+}
+
+} // namespace
+
+ToleranceMask::ToleranceMask(const Image& img, const RGBA& seed,
+                             double tolerance, ColorMetric metric)
+    : img_(&img),
+      seed_(seed),
+      tolerance_(tolerance),
+      metric_(metric),
+      segs_per_row_((img.width() + segment_size - 1) >> segment_shift),
+      bits_(segs_per_row_ * img.height() * words_per_segment, 0),
+      ready_(segs_per_row_ * img.height(), 0) {
+    if (color_metric_memoised(metric) && img.pixel_count() >= memo_min_pixels)
+        verdicts_ = shared_table(seed, tolerance, metric);
+    else
+        bypass_memo_ = 1;
+}
+
+ToleranceMask::ToleranceMask(const PreparedImage& img, const RGBA& seed,
+                             double tolerance)
+    : img_(&img.image()),
+      prepared_(&img),
+      seed_(seed),
+      tolerance_(tolerance),
+      metric_(ColorMetric::Hsl),
+      segs_per_row_((img.width() + segment_size - 1) >> segment_shift),
+      bits_(segs_per_row_ * img.height() * words_per_segment, 0),
+      ready_(segs_per_row_ * img.height(), 0) {}
+
+void ToleranceMask::evaluate_all() {
+    for (std::size_t seg = 0; seg < ready_.size(); ++seg)
+        if (!ready_[seg]) evaluate_segment(seg);
+}
+
+void ToleranceMask::evaluate_segment(std::size_t seg) {
+    const unsigned w  = img_->width();
+    const auto     y  = static_cast<unsigned>(seg / segs_per_row_);
+    const auto     x0 = static_cast<unsigned>(seg % segs_per_row_)
+                        << segment_shift;
+    const std::size_t n = std::min<std::size_t>(segment_size, w - x0);
+
+    static_assert(Image::tile_size % 64 == 0);
+    std::uint64_t* out = &bits_[seg * words_per_segment];
+    if (prepared_) {
+        prepared_->within(x0, y, n, seed_, tolerance_, out);
+        ready_[seg] = 1;
+        TRIPLEFILL_COUNT_SHARED(evaluated_, n);
+        return;
+    }
+    // A tiled image is contiguous over 64-pixel pieces, which start on word
+    // boundaries of the segment's bits; a row-major one in a single piece.
+    for (std::size_t i = 0; i < n;) {
+        const auto x = static_cast<unsigned>(x0 + i);
+        const RGBA* px = &img_->at(x, y);
+        const std::size_t m =
+            std::min<std::size_t>(n - i, img_->contiguous_run(x, y));
+        evaluate_run(px, m, out + (i >> 6));
+        i += m;
+    }
+    ready_[seg] = 1;
+    TRIPLEFILL_COUNT_SHARED(evaluated_, n);
+}
+
+void ToleranceMask::evaluate_run(const RGBA* px, std::size_t n,
+                                 std::uint64_t* out) {
+    // Known colours are answered by the table; the rest are packed together
+    // and run through the kernel, then recorded. Images with hardly any
+    // repeated colours (noise, 16-bit gradients) gain nothing from the
+    // table, so the mask stops using it once the hit rate settles low.
+    std::atomic_ref<std::size_t> lookups(lookups_), hits(hits_);
+    std::atomic_ref<std::uint8_t> bypass(bypass_memo_);
+    if (bypass.load(std::memory_order_relaxed)) {
+        evaluate_kernel(px, n, out);
+        return;
+    }
+
+    RGBA          miss[segment_size];
+    std::uint16_t where[segment_size];
+    std::size_t   misses = 0;
+    for (std::size_t j = 0; j < n; ++j) {
+        const unsigned v = verdicts_->get(rgb_key(px[j]));
+        if (v == VerdictTable::in) {
+            out[j >> 6] |= std::uint64_t{1} << (j & 63);
+        } else if (v == VerdictTable::unknown) {
+            miss[misses]  = px[j];
+            where[misses] = static_cast<std::uint16_t>(j);
+            ++misses;
+        }
+    }
+    const std::size_t seen =
+        lookups.fetch_add(n, std::memory_order_relaxed) + n;
+    const std::size_t hit =
+        hits.fetch_add(n - misses, std::memory_order_relaxed) + n - misses;
+    if (seen >= memo_warmup && hit * 4 < seen)
+        bypass.store(1, std::memory_order_relaxed);
+    if (misses == 0) return;
+
+    std::uint64_t verdict[words_per_segment] = {};
+    evaluate_kernel(miss, misses, verdict);
+    for (std::size_t k = 0; k < misses; ++k) {
+        const bool inside = (verdict[k >> 6] >> (k & 63)) & 1u;
+        verdicts_->put(rgb_key(miss[k]), inside);
+        if (inside) out[where[k] >> 6] |= std::uint64_t{1} << (where[k] & 63);
+    }
+}
+
+void ToleranceMask::evaluate_kernel(const RGBA* px, std::size_t n,
+                                    std::uint64_t* out) const {
+    color_within(px, n, seed_, tolerance_, out, metric_);
+}
+
+std::size_t ToleranceMask::memo_tables() noexcept {
+    return detail::verdict_tables.load(std::memory_order_relaxed);
+}
+
+const char* ToleranceMask::kernel_name() noexcept {
+    return color_within_kernel();
+}
+
+} // namespace triplefill
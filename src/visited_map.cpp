@@ -0,0 +1,40 @@
+#include "triplefill/visited_map.hpp"
+
+#include <algorithm>
+
+namespace triplefill {
+
+VisitedMap::VisitedMap(unsigned w, unsigned h)
+    : w_(w), h_(h), stride_(static_cast<std::size_t>(w) + 2) {
+    const std::size_t cells = stride_ * (static_cast<std::size_t>(h) + 2);
+    bits_.resize((cells + 63) / 64);
+    reset();
+}
+
+void VisitedMap::reset() noexcept {
+    std::fill(bits_.begin(), bits_.end(), std::uint64_t{0});
+
+    // Sentinel border: top and bottom rows, then the left/right columns.
+    const int iw = static_cast<int>(w_);
+    const int ih = static_cast<int>(h_);
+    set_run(-1, -1, iw);
+    set_run(ih, -1, iw);
+    for (int y = 0; y < ih; ++y) {
+        set(-1, y);
+        set(iw, y);
+    }
+}
+
+void VisitedMap::set_run(int y, int xl, int xr) noexcept {
+    std::size_t i   = index(xl, y);
+    std::size_t end = index(xr, y) + 1;
+
+    // Leading partial word
+    while (i < end && (i & 63) != 0) set(i++);
+    // Whole words
+    for (; i + 64 <= end; i += 64) bits_[i >> 6] = ~std::uint64_t{0};
+    // Trailing partial word
+    while (i < end) set(i++);
+}
+
+} // namespace triplefill
@@ -2,10 +2,28 @@
 #include "catch.hpp"
 
 #include "triplefill/fill.hpp"
+#include "triplefill/fill_cache.hpp"
+#include "triplefill/fill_session.hpp"
+#include "triplefill/frame_sink.hpp"
+#include "triplefill/frame_generator.hpp"
 #include "triplefill/image.hpp"
+#include "triplefill/paged_fill.hpp"
+#include "triplefill/prepared_image.hpp"
+#include "triplefill/pickers/quarter.hpp"
+#include "triplefill/selection.hpp"
+#include "triplefill/tile_canvas.hpp"
+#include "triplefill/tolerance_map.hpp"
+#include "triplefill/tolerance_mask.hpp"
 
+#include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <cstring>
 #include <filesystem>
+#include <fstream>
+#include <limits>
+#include <optional>
+#include <sstream>
 
 using namespace triplefill;
 namespace fs = std::filesystem;
@@ -266,3 +284,1329 @@ TEST_CASE("FillStats records filled_pixels and frames_captured", "[fill][stats]"
     REQUIRE(anim.stats().filled_pixels == 25);
     REQUIRE(anim.stats().frames_captured == anim.size());
 }
+
+TEST_CASE("FillStats records the frontier high-water mark", "[fill][stats]") {
+    auto img = make_solid(64, 48, RGBA{100, 100, 100});
+
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        FillConfig cfg{
+            .seed       = {10, 20},
+            .tolerance  = 0.5,
+            .frame_freq = 0,
+            .algorithm  = algo,
+            .picker     = SolidPicker{RGBA{0, 255, 0}},
+        };
+        auto anim = flood_fill(img, cfg);
+        REQUIRE(anim.stats().filled_pixels == 64 * 48);
+        if (algo == Algorithm::Parallel) {
+            REQUIRE(anim.stats().frontier_peak == 0);
+        } else {
+            REQUIRE(anim.stats().frontier_peak > 0);
+            REQUIRE(anim.stats().frontier_peak <= anim.stats().filled_pixels);
+        }
+    }
+
+    // A BFS wavefront on an open image stays within the perimeter.
+    FillConfig bfs{.seed = {32, 24}, .tolerance = 0.5, .frame_freq = 0};
+    REQUIRE(flood_fill(img, bfs).stats().frontier_peak <= 2 * (64 + 48));
+}
+
+// ---------------------------------------------------------------------------
+// Scanline engine
+// ---------------------------------------------------------------------------
+
+// Helper: image with an irregular in-tolerance region (concave pockets,
+// islands and a diagonal wall) so span seeding is exercised in both rows.
+static Image make_maze(unsigned w, unsigned h) {
+    Image img(w, h, RGBA{100, 100, 100});
+    for (unsigned y = 0; y < h; ++y) {
+        for (unsigned x = 0; x < w; ++x) {
+            if ((x % 7 == 3 && y % 5 != 0) || (y % 9 == 4 && x % 11 > 2) ||
+                x == y)
+                img.at(x, y) = RGBA{0, 0, 0};
+        }
+    }
+    return img;
+}
+
+TEST_CASE("Scanline fills the same region as BFS", "[fill][scanline]") {
+    auto img = make_maze(41, 37);
+    FillConfig cfg{
+        .seed       = {1, 20},
+        .tolerance  = 0.05,
+        .frame_freq = 0,
+        .algorithm  = Algorithm::BFS,
+        .picker     = SolidPicker{RGBA{255, 0, 0}},
+    };
+
+    auto bfs = flood_fill(img, cfg);
+    cfg.algorithm = Algorithm::Scanline;
+    auto scan = flood_fill(img, cfg);
+
+    REQUIRE(images_match(bfs.final_frame(), scan.final_frame()));
+    REQUIRE(scan.stats().filled_pixels == bfs.stats().filled_pixels);
+}
+
+TEST_CASE("Scanline captures a frame every frame_freq pixels",
+          "[fill][scanline][frames]") {
+    auto img = make_solid(10, 10, RGBA{50, 50, 50});
+    FillConfig cfg{
+        .seed       = {4, 6},
+        .tolerance  = 1.0,
+        .frame_freq = 7,
+        .algorithm  = Algorithm::Scanline,
+        .picker     = SolidPicker{RGBA{200, 0, 0}},
+    };
+
+    auto anim = flood_fill(img, cfg);
+    // 100 pixels / freq 7 = 14 intermediate + 1 final = 15
+    REQUIRE(anim.size() == 15);
+
+    // Frame k shows exactly 7*(k+1) coloured pixels
+    for (std::size_t k = 0; k + 1 < anim.size(); ++k) {
+        std::size_t coloured = 0;
+        for (std::size_t i = 0; i < 100; ++i)
+            coloured += anim.frame(k).data()[i] == RGBA{200, 0, 0};
+        REQUIRE(coloured == 7 * (k + 1));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Parallel tiled labelling
+// ---------------------------------------------------------------------------
+
+TEST_CASE("Parallel fills the same region as Scanline across tile seams",
+          "[fill][parallel]") {
+    // Several 256x256 tiles in both directions; the maze walls make the
+    // region cross seams many times.
+    auto img = make_maze(700, 530);
+    FillConfig cfg{
+        .seed       = {1, 20},
+        .tolerance  = 0.05,
+        .frame_freq = 0,
+        .algorithm  = Algorithm::Scanline,
+        .picker     = SolidPicker{RGBA{255, 0, 0}},
+    };
+    auto scan = flood_fill(img, cfg);
+
+    for (unsigned threads : {1u, 4u}) {
+        cfg.algorithm  = Algorithm::Parallel;
+        cfg.frame_freq = 100; // ignored by Parallel
+        cfg.threads    = threads;
+        auto par = flood_fill(img, cfg);
+
+        REQUIRE(par.size() == 1); // final frame only
+        REQUIRE(par.stats().filled_pixels == scan.stats().filled_pixels);
+        REQUIRE(images_match(par.final_frame(), scan.final_frame()));
+    }
+}
+
+TEST_CASE("Parallel paints the seed outside its own tolerance",
+          "[fill][parallel]") {
+    const auto img = make_solid(300, 300, RGBA{100, 100, 100});
+    for (double tolerance : {-0.5, std::numeric_limits<double>::quiet_NaN()}) {
+        FillConfig cfg{
+            .seed       = {150, 260},
+            .tolerance  = tolerance,
+            .frame_freq = 0,
+            .algorithm  = Algorithm::Scanline,
+            .picker     = SolidPicker{RGBA{255, 0, 0}},
+        };
+        const auto scan = flood_fill(img, cfg);
+        cfg.algorithm = Algorithm::Parallel;
+        cfg.threads   = 2;
+        const auto par = flood_fill(img, cfg);
+
+        REQUIRE(par.stats().filled_pixels == 1);
+        REQUIRE(par.stats().filled_pixels == scan.stats().filled_pixels);
+        REQUIRE(images_match(par.final_frame(), scan.final_frame()));
+    }
+}
+
+TEST_CASE("Parallel BorderPicker sees the complete region",
+          "[fill][parallel][border]") {
+    auto img = make_solid(12, 9, RGBA{100, 100, 100});
+    FillConfig cfg{
+        .seed       = {6, 4},
+        .tolerance  = 0.5,
+        .frame_freq = 0,
+        .algorithm  = Algorithm::Parallel,
+        .picker     = BorderPicker{RGBA{0, 255, 0}, RGBA{255, 0, 0}, 1},
+        .threads    = 2,
+    };
+
+    auto anim = flood_fill(img, cfg);
+    const auto& result = anim.final_frame();
+    for (unsigned y = 0; y < 9; ++y) {
+        for (unsigned x = 0; x < 12; ++x) {
+            const bool edge = x == 0 || y == 0 || x == 11 || y == 8;
+            REQUIRE(result.at(x, y) ==
+                    (edge ? RGBA{255, 0, 0} : RGBA{0, 255, 0}));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// flood_fill_many
+// ---------------------------------------------------------------------------
+
+TEST_CASE("flood_fill_many matches individual flood_fill calls",
+          "[fill][many]") {
+    auto img = make_maze(60, 45);
+    // Left-side islands share the seed colour; (30, 30) starts on a wall.
+    std::vector<FillConfig> cfgs{
+        {.seed = {1, 20}, .tolerance = 0.05, .frame_freq = 0,
+         .picker = SolidPicker{RGBA{255, 0, 0}}},
+        {.seed = {2, 21}, .tolerance = 0.05, .frame_freq = 0,
+         .algorithm = Algorithm::Scanline,
+         .picker = StripePicker{RGBA{1, 2, 3}, RGBA{4, 5, 6}, 3}},
+        {.seed = {1, 20}, .tolerance = 0.05, .frame_freq = 50,
+         .algorithm = Algorithm::DFS,
+         .picker = SolidPicker{RGBA{0, 0, 255}}},
+        {.seed = {30, 30}, .tolerance = 0.05, .frame_freq = 0,
+         .picker = QuarterPicker{RGBA{10, 200, 10}}},
+        {.seed = {2, 21}, .tolerance = 0.05, .frame_freq = 0,
+         .picker = BorderPicker{RGBA{0, 255, 0}, RGBA{9, 9, 9}, 2}},
+        {.seed = {-1, 5}},
+    };
+
+    for (unsigned threads : {1u, 3u}) {
+        auto many = flood_fill_many(img, cfgs, threads);
+        REQUIRE(many.size() == cfgs.size());
+        for (std::size_t i = 0; i < cfgs.size(); ++i) {
+            auto single = flood_fill(img, cfgs[i]);
+            REQUIRE(many[i].size() == single.size());
+            REQUIRE(many[i].stats().filled_pixels ==
+                    single.stats().filled_pixels);
+            for (std::size_t f = 0; f < single.size(); ++f)
+                REQUIRE(images_match(many[i].frame(f), single.frame(f)));
+        }
+    }
+}
+
+TEST_CASE("flood_fill_many keeps a few tolerance masks per worker",
+          "[fill][many]") {
+    // Sixteen stripes of distinct colours, each filled with its own mask
+    // and colour memo table
+    Image img(1024, 1024);
+    for (unsigned y = 0; y < img.height(); ++y)
+        for (unsigned x = 0; x < img.width(); ++x)
+            img.at(x, y) = RGBA{static_cast<std::uint8_t>(x / 64 * 16),
+                                static_cast<std::uint8_t>(255 - x / 64 * 16),
+                                100};
+
+    const std::size_t tables = ToleranceMask::memo_tables();
+    std::size_t peak = 0;
+    std::vector<FillConfig> batch;
+    for (int s = 0; s < 16; ++s) {
+        batch.push_back({.seed = {s * 64 + 3, 500}, .tolerance = 0.01,
+                         .frame_freq = 0,
+                         .on_progress = [&](std::size_t, std::size_t) {
+                             peak = std::max(peak, ToleranceMask::memo_tables() -
+                                                       tables);
+                         }});
+    }
+    const auto many = flood_fill_many(img, batch, 1);
+    for (const auto& anim : many)
+        REQUIRE(anim.stats().filled_pixels == 64 * 1024);
+    REQUIRE(peak > 0);
+    REQUIRE(peak <= 4);
+    REQUIRE(ToleranceMask::memo_tables() == tables);
+}
+
+// ---------------------------------------------------------------------------
+// Statically dispatched pickers
+// ---------------------------------------------------------------------------
+
+TEST_CASE("Quarter fill matches pick_quarter at every pixel",
+          "[fill][quarter]") {
+    auto img = make_solid(13, 10, RGBA{90, 90, 90});
+    QuarterPicker qp{RGBA{120, 40, 200}, 30};
+
+    for (auto algo : {Algorithm::BFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        FillConfig cfg{
+            .seed       = {3, 3},
+            .tolerance  = 0.5,
+            .frame_freq = 0,
+            .algorithm  = algo,
+            .picker     = qp,
+        };
+        auto anim = flood_fill(img, cfg);
+
+        QuarterPicker centred = qp;
+        centred.center = Point{6, 5}; // auto-centre: (w/2, h/2)
+        for (unsigned y = 0; y < 10; ++y)
+            for (unsigned x = 0; x < 13; ++x)
+                REQUIRE(anim.final_frame().at(x, y) ==
+                        pick_quarter(centred,
+                                     {static_cast<int>(x), static_cast<int>(y)},
+                                     RGBA{}));
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Tiled image storage
+// ---------------------------------------------------------------------------
+
+TEST_CASE("Tiled layout round-trips through row-major", "[image][tiled]") {
+    // Partial edge blocks in both directions
+    auto img = make_maze(150, 97);
+    auto tiled = img.converted(Layout::Tiled);
+    REQUIRE(tiled.layout() == Layout::Tiled);
+    for (unsigned y = 0; y < 97; ++y)
+        for (unsigned x = 0; x < 150; ++x)
+            REQUIRE(tiled.at(x, y) == img.at(x, y));
+    REQUIRE(tiled == img);
+
+    auto back = tiled.converted(Layout::RowMajor);
+    REQUIRE(back.layout() == Layout::RowMajor);
+    REQUIRE(images_match(back, img));
+
+    auto tmp = fs::temp_directory_path() / "triplefill_tiled.png";
+    save_png(tmp, tiled);
+    REQUIRE(images_match(load_png(tmp), img));
+    fs::remove(tmp);
+}
+
+TEST_CASE("Fills on a tiled image match the row-major result",
+          "[fill][tiled]") {
+    auto img   = make_maze(150, 97);
+    auto tiled = img.converted(Layout::Tiled);
+
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        FillConfig cfg{
+            .seed       = {1, 2},
+            .tolerance  = 0.1,
+            .frame_freq = algo == Algorithm::Parallel ? 0 : 700,
+            .algorithm  = algo,
+            .picker     = StripePicker{RGBA{255, 0, 0}, RGBA{0, 0, 255}, 3},
+        };
+        auto ref = flood_fill(img, cfg);
+        auto got = flood_fill(tiled, cfg);
+        REQUIRE(got.size() == ref.size());
+        REQUIRE(got.stats().filled_pixels == ref.stats().filled_pixels);
+        for (std::size_t f = 0; f < ref.size(); ++f) {
+            REQUIRE(got.frame(f).layout() == Layout::Tiled);
+            REQUIRE(got.frame(f) == ref.frame(f));
+        }
+    }
+}
+
+// ---------------------------------------------------------------------------
+// Resumable sessions
+// ---------------------------------------------------------------------------
+
+TEST_CASE("FillSession stepped to completion matches flood_fill",
+          "[fill][session]") {
+    auto img = make_maze(150, 97);
+
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        for (std::size_t budget : {std::size_t{1}, std::size_t{37},
+                                   std::size_t{5000}}) {
+            FillConfig cfg{
+                .seed       = {1, 2},
+                .tolerance  = 0.1,
+                .frame_freq = algo == Algorithm::Parallel ? 0 : 300,
+                .algorithm  = algo,
+                .picker     = BorderPicker{RGBA{0, 255, 0}, RGBA{255, 0, 0}, 2},
+                .max_frames = 5,
+            };
+            auto ref = flood_fill(img, cfg);
+
+            FillSession session(img, cfg);
+            std::vector<Image> frames;
+            Image before = session.canvas();
+            std::size_t painted = 0;
+            while (!session.done()) {
+                auto step = session.step(budget);
+                if (algo != Algorithm::Parallel)
+                    REQUIRE(step.painted <= budget);
+                painted += step.painted;
+
+                // Every changed pixel lies inside the dirty rectangle
+                const Image& now = session.canvas();
+                for (unsigned y = 0; y < 97 && budget > 1; ++y)
+                    for (unsigned x = 0; x < 150; ++x)
+                        if (!(now.at(x, y) == before.at(x, y)))
+                            REQUIRE((static_cast<int>(x) >= step.dirty.x0 &&
+                                     static_cast<int>(x) < step.dirty.x1 &&
+                                     static_cast<int>(y) >= step.dirty.y0 &&
+                                     static_cast<int>(y) < step.dirty.y1));
+                before = now;
+
+                for (auto& f : step.frames) frames.push_back(std::move(f));
+            }
+
+            REQUIRE(painted == ref.stats().filled_pixels);
+            REQUIRE(session.stats().filled_pixels == painted);
+            REQUIRE(session.stats().frames_captured == frames.size());
+            REQUIRE(frames.size() + 1 == ref.size());
+            for (std::size_t f = 0; f < frames.size(); ++f)
+                REQUIRE(frames[f] == ref.frame(f));
+            REQUIRE(session.canvas() == ref.final_frame());
+            REQUIRE(session.step(budget).done);
+        }
+    }
+}
+
+TEST_CASE("FillSession with an out-of-bounds seed is already done",
+          "[fill][session]") {
+    auto img = make_solid(8, 8, RGBA{1, 2, 3});
+    FillSession session(img, FillConfig{.seed = {8, 0}});
+    REQUIRE(session.done());
+    auto step = session.step(100);
+    REQUIRE(step.done);
+    REQUIRE(step.painted == 0);
+    REQUIRE(step.dirty.empty());
+    REQUIRE(session.canvas() == img);
+}
+
+// ---------------------------------------------------------------------------
+// Lazy frame generator
+// ---------------------------------------------------------------------------
+
+TEST_CASE("flood_fill_frames yields the frames flood_fill stores",
+          "[fill][generator]") {
+    auto img = make_maze(150, 97);
+
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        for (std::optional<std::size_t> max_frames :
+             {std::optional<std::size_t>{}, std::optional<std::size_t>{3}}) {
+            FillConfig cfg{
+                .seed       = {1, 2},
+                .tolerance  = 0.1,
+                .frame_freq = 250,
+                .algorithm  = algo,
+                .picker     = StripePicker{RGBA{255, 0, 0}, RGBA{0, 0, 255}, 3},
+                .max_frames = max_frames,
+            };
+            auto ref = flood_fill(img, cfg);
+
+            std::size_t n = 0;
+            for (const Image& frame : flood_fill_frames(img, cfg)) {
+                REQUIRE(n < ref.size());
+                REQUIRE(frame == ref.frame(n));
+                ++n;
+            }
+            REQUIRE(n == ref.size());
+        }
+    }
+
+    // A fill that ends exactly on a frame boundary yields that frame and
+    // the final frame, as flood_fill does.
+    auto small = make_solid(5, 4, RGBA{10, 10, 10});
+    FillConfig cfg{.seed = {0, 0}, .tolerance = 0.5, .frame_freq = 10};
+    std::size_t n = 0;
+    for ([[maybe_unused]] const Image& frame : flood_fill_frames(small, cfg)) ++n;
+    REQUIRE(n == flood_fill(small, cfg).size());
+    REQUIRE(n == 3);
+
+    // Out-of-bounds seed: nothing
+    cfg.seed = {-1, 0};
+    auto gen = flood_fill_frames(small, cfg);
+    REQUIRE(gen.begin() == gen.end());
+}
+
+TEST_CASE("Streaming GIF output matches Animation::write_gif",
+          "[fill][generator][gif]") {
+    auto img = make_maze(60, 40);
+    FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1, .frame_freq = 200};
+
+    auto a = fs::temp_directory_path() / "triplefill_stored.gif";
+    auto b = fs::temp_directory_path() / "triplefill_streamed.gif";
+    flood_fill(img, cfg).write_gif(a);
+    write_gif(b, flood_fill_frames(img, cfg));
+
+    auto slurp = [](const fs::path& p) {
+        std::ifstream in(p, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    };
+    REQUIRE(slurp(a) == slurp(b));
+    fs::remove(a);
+    fs::remove(b);
+}
+
+TEST_CASE("flood_fill streams frames to a FrameSink", "[fill][sink]") {
+    const auto img = make_maze(60, 40).converted(Layout::Tiled);
+    FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1, .frame_freq = 200,
+                   .picker = StripePicker{RGBA{255, 0, 0}, RGBA{0, 0, 255}, 3}};
+    const auto stored = flood_fill(img, cfg);
+    REQUIRE(stored.size() > 3);
+
+    // A sink of its own sees the same frames, a view at a time
+    struct Collect final : FrameSink {
+        std::vector<Image> frames;
+        void frame(const Image& canvas, Changes changed) override {
+            REQUIRE(!changed);
+            frames.push_back(canvas);
+        }
+    } collect;
+    auto stats = flood_fill(img, cfg, collect);
+    REQUIRE(collect.frames.size() == stored.size());
+    REQUIRE(stats.frames_captured == stored.size());
+    REQUIRE(stats.filled_pixels == stored.stats().filled_pixels);
+    for (std::size_t i = 0; i < stored.size(); ++i)
+        REQUIRE(collect.frames[i] == stored.frame(i));
+
+    Animation anim;
+    AnimationSink to_anim(anim);
+    flood_fill(img, cfg, to_anim);
+    REQUIRE(anim.size() == stored.size());
+    for (std::size_t i = 0; i < stored.size(); ++i)
+        REQUIRE(anim.frame(i) == stored.frame(i));
+
+    // Raw frames are row-major whatever the canvas layout
+    std::ostringstream raw_out;
+    RawSink raw(raw_out);
+    flood_fill(img, cfg, raw);
+    const std::string bytes = raw_out.str();
+    const std::size_t frame_bytes = img.pixel_count() * sizeof(RGBA);
+    REQUIRE(raw.frames() == stored.size());
+    REQUIRE(bytes.size() == stored.size() * frame_bytes);
+    const Image last = stored.final_frame().converted(Layout::RowMajor);
+    REQUIRE(std::memcmp(bytes.data() + bytes.size() - frame_bytes, last.data(),
+                        frame_bytes) == 0);
+
+    auto dir = fs::temp_directory_path() / "triplefill_sink_frames";
+    fs::create_directories(dir);
+    PngSequenceSink pngs(dir);
+    flood_fill(img, cfg, pngs);
+    REQUIRE(pngs.frames() == stored.size());
+    REQUIRE(load_png(dir / "frame_00001.png") == stored.frame(1));
+    fs::remove_all(dir);
+
+    auto a = fs::temp_directory_path() / "triplefill_stored.gif";
+    auto b = fs::temp_directory_path() / "triplefill_sink.gif";
+    stored.write_gif(a);
+    {
+        GifSink gif(b);
+        flood_fill(img, cfg, gif);
+        gif.close();
+    }
+    auto slurp = [](const fs::path& p) {
+        std::ifstream in(p, std::ios::binary);
+        return std::string(std::istreambuf_iterator<char>(in), {});
+    };
+    REQUIRE(slurp(a) == slurp(b));
+    fs::remove(a);
+    fs::remove(b);
+
+    // Out-of-bounds seed: nothing sent
+    cfg.seed = {-1, 0};
+    GifSink empty(b);
+    REQUIRE(flood_fill(img, cfg, empty).filled_pixels == 0);
+    REQUIRE_THROWS_AS(empty.close(), std::runtime_error);
+    REQUIRE(!fs::exists(b));
+}
+
+// ---------------------------------------------------------------------------
+// Cancellation and budgets
+// ---------------------------------------------------------------------------
+
+static std::size_t count_changed(const Image& a, const Image& b) {
+    std::size_t n = 0;
+    for (unsigned y = 0; y < a.height(); ++y)
+        for (unsigned x = 0; x < a.width(); ++x)
+            n += !(a.at(x, y) == b.at(x, y));
+    return n;
+}
+
+TEST_CASE("max_pixels truncates the fill", "[fill][limits]") {
+    auto img = make_maze(150, 97);
+
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline}) {
+        FillConfig cfg{
+            .seed       = {1, 2},
+            .tolerance  = 0.1,
+            .frame_freq = 0,
+            .algorithm  = algo,
+            .picker     = SolidPicker{RGBA{0, 255, 0}},
+        };
+        const auto full = flood_fill(img, cfg).stats();
+        REQUIRE(!full.truncated());
+
+        cfg.max_pixels = 1000;
+        auto anim = flood_fill(img, cfg);
+        REQUIRE(anim.stats().stop == StopReason::PixelBudget);
+        REQUIRE(anim.stats().filled_pixels == 1000);
+        REQUIRE(count_changed(img, anim.final_frame()) == 1000);
+
+        // A budget that covers the region is not a truncation
+        cfg.max_pixels = full.filled_pixels;
+        REQUIRE(flood_fill(img, cfg).stats().stop == StopReason::Complete);
+    }
+
+    // Parallel cannot stop part-way through painting
+    FillConfig par{
+        .seed       = {1, 2},
+        .tolerance  = 0.1,
+        .algorithm  = Algorithm::Parallel,
+        .max_pixels = 1000,
+    };
+    auto anim = flood_fill(img, par);
+    REQUIRE(anim.stats().stop == StopReason::PixelBudget);
+    REQUIRE(anim.stats().filled_pixels == 0);
+    REQUIRE(anim.final_frame() == img);
+}
+
+TEST_CASE("Cancel token and deadline stop the fill", "[fill][limits]") {
+    auto img = make_solid(300, 200, RGBA{50, 50, 50});
+
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        // Cancelled before it starts
+        FillConfig cfg{.seed = {5, 5}, .frame_freq = 0, .algorithm = algo};
+        cfg.cancel = CancelToken::make();
+        cfg.cancel.cancel();
+        auto anim = flood_fill(img, cfg);
+        REQUIRE(anim.stats().stop == StopReason::Cancelled);
+        REQUIRE(anim.stats().filled_pixels == 0);
+
+        // Deadline already passed
+        cfg.cancel   = {};
+        cfg.deadline = std::chrono::steady_clock::now();
+        anim = flood_fill(img, cfg);
+        REQUIRE(anim.stats().stop == StopReason::Deadline);
+        REQUIRE(anim.stats().filled_pixels == 0);
+    }
+
+    // Cancelled part-way: stops within one polling interval
+    FillConfig cfg{.seed = {5, 5}, .frame_freq = 0};
+    cfg.cancel = CancelToken::make();
+    cfg.on_progress = [token = cfg.cancel](std::size_t filled, std::size_t) {
+        if (filled == 10000) token.cancel();
+    };
+    auto anim = flood_fill(img, cfg);
+    REQUIRE(anim.stats().truncated());
+    REQUIRE(anim.stats().stop == StopReason::Cancelled);
+    REQUIRE(anim.stats().filled_pixels >= 10000);
+    REQUIRE(anim.stats().filled_pixels <= 10000 + stop_check_interval);
+}
+
+TEST_CASE("FillSession applies max_pixels across steps", "[fill][limits]") {
+    auto img = make_maze(150, 97);
+    FillConfig cfg{
+        .seed       = {1, 2},
+        .tolerance  = 0.1,
+        .algorithm  = Algorithm::Scanline,
+        .max_pixels = 777,
+    };
+    FillSession session(img, cfg);
+    while (!session.done()) REQUIRE(session.step(100).painted <= 100);
+    REQUIRE(session.stats().filled_pixels == 777);
+    REQUIRE(session.stats().stop == StopReason::PixelBudget);
+}
+
+TEST_CASE("Telemetry counts hot-path events when enabled", "[fill][stats]") {
+    auto img = make_maze(120, 80);
+
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1, .frame_freq = 500,
+                       .algorithm = algo};
+        auto anim = flood_fill(img, cfg);
+        const FillStats& s = anim.stats();
+        const FillTelemetry& t = s.telemetry;
+
+        if constexpr (!telemetry_enabled) {
+            REQUIRE(t.tolerance_evaluations == 0);
+            REQUIRE(t.neighbour_tests == 0);
+            REQUIRE(t.picker_calls == 0);
+            REQUIRE(t.frame_copy_bytes == 0);
+            REQUIRE(t.traverse_seconds == 0);
+            continue;
+        }
+
+        REQUIRE(t.picker_calls == s.filled_pixels);
+        REQUIRE(t.tolerance_evaluations > 0);
+        REQUIRE(t.tolerance_evaluations <= img.pixel_count());
+        // Too small for the colour memo
+        REQUIRE(t.memo_hits == 0);
+        // Intermediate frames store each painted pixel's offset and colour
+        REQUIRE(t.frame_copy_bytes ==
+                (anim.size() - 1) * 500 * (sizeof(std::uint32_t) + sizeof(RGBA)));
+        if (algo == Algorithm::BFS || algo == Algorithm::DFS) {
+            // Every filled pixel but the seed entered through one test
+            REQUIRE(t.neighbour_tests - t.rejected_neighbours ==
+                    s.filled_pixels - 1);
+        }
+        if (algo != Algorithm::Parallel) REQUIRE(t.rejected_neighbours > 0);
+    }
+}
+
+TEST_CASE("Eight-connected fills cross diagonal gaps", "[fill][connectivity]") {
+    // Both diagonals of a 300x300 image; they cross Parallel tile seams.
+    const unsigned n = 300;
+    Image img(n, n, RGBA{200, 200, 200});
+    for (unsigned i = 0; i < n; ++i) {
+        img.at(i, i)         = RGBA{0, 0, 0};
+        img.at(n - 1 - i, i) = RGBA{0, 0, 0};
+    }
+
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        FillConfig cfg{.seed = {0, 0}, .tolerance = 0.05, .frame_freq = 0,
+                       .algorithm = algo};
+        REQUIRE(flood_fill(img, cfg).stats().filled_pixels == 1);
+        cfg.connectivity = Connectivity::Eight;
+        REQUIRE(flood_fill(img, cfg).stats().filled_pixels == 2 * n);
+
+        // The background quarters only touch through the lines' corners
+        cfg.seed = {n / 2, 5};
+        cfg.connectivity = Connectivity::Four;
+        const auto four = flood_fill(img, cfg).stats().filled_pixels;
+        cfg.connectivity = Connectivity::Eight;
+        const auto eight = flood_fill(img, cfg).stats().filled_pixels;
+        REQUIRE(four < eight);
+        REQUIRE(eight == std::size_t{n} * n - 2 * n);
+    }
+}
+
+TEST_CASE("Eight-connected fills agree across algorithms", "[fill][connectivity]") {
+    auto img = make_maze(150, 97);
+    FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1, .frame_freq = 0,
+                   .connectivity = Connectivity::Eight};
+    auto bfs = flood_fill(img, cfg);
+    for (auto algo : {Algorithm::DFS, Algorithm::Scanline,
+                      Algorithm::Parallel}) {
+        cfg.algorithm = algo;
+        auto other = flood_fill(img, cfg);
+        REQUIRE(other.stats().filled_pixels == bfs.stats().filled_pixels);
+        REQUIRE(images_match(other.final_frame(), bfs.final_frame()));
+    }
+
+    // And through a session and the batch path
+    FillSession session(img, cfg);
+    while (!session.done()) session.step(100);
+    REQUIRE(images_match(session.canvas(), bfs.final_frame()));
+
+    FillConfig four = cfg;
+    four.connectivity = Connectivity::Four;
+    std::vector<FillConfig> batch{four, cfg, four, cfg};
+    auto many = flood_fill_many(img, batch);
+    REQUIRE(images_match(many[1].final_frame(), bfs.final_frame()));
+    REQUIRE(images_match(many[3].final_frame(), bfs.final_frame()));
+    REQUIRE(images_match(many[0].final_frame(),
+                         flood_fill(img, four).final_frame()));
+}
+
+TEST_CASE("Eight-connected BFS pushes neighbours clockwise from North",
+          "[fill][connectivity]") {
+    Image img(3, 3, RGBA{10, 10, 10});
+    FillConfig cfg{.seed = {1, 1}, .frame_freq = 1,
+                   .connectivity = Connectivity::Eight};
+    auto anim = flood_fill(img, cfg);
+    REQUIRE(anim.size() == 10); // one frame per pixel plus the final frame
+
+    const Point order[] = {{1, 1}, {1, 0}, {2, 0}, {2, 1}, {2, 2},
+                           {1, 2}, {0, 2}, {0, 1}, {0, 0}};
+    for (std::size_t i = 0; i < 9; ++i) {
+        const auto& f = anim.frame(i);
+        REQUIRE(f.at(order[i].x, order[i].y) == RGBA{255, 0, 0});
+        if (i + 1 < 9)
+            REQUIRE(f.at(order[i + 1].x, order[i + 1].y) == RGBA{10, 10, 10});
+    }
+}
+
+TEST_CASE("flood_select returns the filled region as sorted spans",
+          "[select]") {
+    auto img = make_maze(150, 97);
+
+    for (auto conn : {Connectivity::Four, Connectivity::Eight}) {
+        FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1, .frame_freq = 0,
+                       .connectivity = conn};
+        auto filled = flood_fill(img, cfg).final_frame();
+        auto sel = flood_select(img, cfg, true);
+
+        REQUIRE_FALSE(sel.truncated());
+        REQUIRE(sel.pixel_count == count_changed(img, filled));
+        REQUIRE(sel.mask.has_value());
+
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < sel.spans.size(); ++i) {
+            const Span& s = sel.spans[i];
+            total += s.length();
+            if (i > 0) {
+                const Span& p = sel.spans[i - 1];
+                REQUIRE((p.y < s.y || p.x1 + 1 < s.x0));
+            }
+        }
+        REQUIRE(total == sel.pixel_count);
+
+        for (unsigned y = 0; y < img.height(); ++y) {
+            for (unsigned x = 0; x < img.width(); ++x) {
+                const Point p{static_cast<int>(x), static_cast<int>(y)};
+                const bool in = !(filled.at(x, y) == img.at(x, y));
+                REQUIRE(sel.contains(p) == in);
+                REQUIRE(sel.mask->filled(p.x, p.y) == in);
+            }
+        }
+    }
+
+    // A solid image is one span per row
+    auto solid = flood_select(make_solid(40, 30, RGBA{9, 9, 9}),
+                              FillConfig{.seed = {3, 4}});
+    REQUIRE(solid.spans.size() == 30);
+    REQUIRE(solid.spans.front() == Span{0, 0, 39});
+    REQUIRE_FALSE(solid.mask.has_value());
+
+    REQUIRE(flood_select(img, FillConfig{.seed = {-1, 0}}).spans.empty());
+}
+
+TEST_CASE("flood_select honours max_pixels exactly", "[select][limits]") {
+    auto img = make_solid(100, 50, RGBA{1, 2, 3});
+    FillConfig cfg{.seed = {10, 10}, .max_pixels = 250};
+    auto sel = flood_select(img, cfg);
+    REQUIRE(sel.stop == StopReason::PixelBudget);
+    REQUIRE(sel.pixel_count == 250);
+
+    cfg.max_pixels = 5000; // the whole image
+    REQUIRE(flood_select(img, cfg).stop == StopReason::Complete);
+
+    // A budget that cuts the only run still stops, and keeps the seed
+    const auto row = make_solid(10, 1, RGBA{1, 2, 3});
+    for (int seed : {8, 2}) {
+        const FillConfig short_cfg{.seed = {seed, 0}, .max_pixels = 5};
+        const auto cut = flood_select(row, short_cfg, true);
+        REQUIRE(cut.stop == StopReason::PixelBudget);
+        REQUIRE(cut.pixel_count == 5);
+        REQUIRE(cut.spans.size() == 1);
+        REQUIRE(cut.spans[0].length() == 5);
+        REQUIRE(cut.contains({seed, 0}));
+        for (int x = 0; x < 10; ++x)
+            REQUIRE(cut.mask->filled(x, 0) == cut.contains({x, 0}));
+    }
+
+    // Stopped before the first pixel, as flood_fill is
+    const auto token = CancelToken::make();
+    token.cancel();
+    const auto cancelled =
+        flood_select(img, FillConfig{.seed = {10, 10}, .cancel = token});
+    REQUIRE(cancelled.stop == StopReason::Cancelled);
+    REQUIRE(cancelled.pixel_count == 0);
+}
+
+static void write_raw(const fs::path& path, const Image& img) {
+    std::ofstream out(path, std::ios::binary);
+    for (unsigned y = 0; y < img.height(); ++y)
+        for (unsigned x = 0; x < img.width(); ++x)
+            out.write(reinterpret_cast<const char*>(&img.at(x, y)), 4);
+}
+
+static Image read_raw(const fs::path& path, unsigned w, unsigned h) {
+    Image img(w, h);
+    std::ifstream in(path, std::ios::binary);
+    for (unsigned y = 0; y < h; ++y)
+        for (unsigned x = 0; x < w; ++x)
+            in.read(reinterpret_cast<char*>(&img.at(x, y)), 4);
+    return img;
+}
+
+TEST_CASE("flood_fill_file pages tiles and matches flood_fill",
+          "[fill][paged]") {
+    // Spans several tiles in each direction, with partial edge tiles
+    auto img = make_maze(700, 530);
+    auto in  = fs::temp_directory_path() / "triplefill_paged_in.rgba";
+    auto out = fs::temp_directory_path() / "triplefill_paged_out.rgba";
+    write_raw(in, img);
+
+    const PickerConfig pickers[] = {
+        StripePicker{RGBA{255, 0, 0}, RGBA{0, 0, 255}, 7},
+        BorderPicker{RGBA{0, 200, 0}, RGBA{20, 20, 20}, 2},
+    };
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline}) {
+        for (const auto& picker : pickers) {
+            for (auto conn : {Connectivity::Four, Connectivity::Eight}) {
+                FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1,
+                               .frame_freq = 0, .algorithm = algo,
+                               .picker = picker, .connectivity = conn};
+                // Fewer resident tiles than the image's nine force
+                // eviction; BFS and DFS wander, so give them more room.
+                const std::size_t resident =
+                    algo == Algorithm::Scanline ? 4 : 6;
+                auto stats = flood_fill_file(in, out, img.width(),
+                                             img.height(), cfg, resident);
+                auto expected = flood_fill(img, cfg);
+                REQUIRE(stats.filled_pixels ==
+                        expected.stats().filled_pixels);
+                REQUIRE(images_match(read_raw(out, img.width(), img.height()),
+                                     expected.final_frame()));
+            }
+        }
+    }
+
+    // The limits apply, and the input is left alone
+    FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1,
+                   .algorithm = Algorithm::Scanline, .max_pixels = 1234};
+    auto stats = flood_fill_file(in, out, img.width(), img.height(), cfg);
+    REQUIRE(stats.stop == StopReason::PixelBudget);
+    REQUIRE(count_changed(img, read_raw(out, img.width(), img.height())) ==
+            1234);
+    REQUIRE(images_match(read_raw(in, img.width(), img.height()), img));
+
+    REQUIRE_THROWS_AS(flood_fill_file(in, out, 701, 530, cfg),
+                      std::runtime_error);
+
+    fs::remove(in);
+    fs::remove(out);
+}
+
+TEST_CASE("FillCache reuses regions and evicts by bytes", "[fill][cache]") {
+    auto img = make_maze(97, 61);
+    REQUIRE(image_digest(img) == image_digest(img.converted(Layout::Tiled)));
+    auto changed = img;
+    changed.at(50, 30) = RGBA{1, 2, 3};
+    REQUIRE(image_digest(changed) != image_digest(img));
+
+    FillCache cache;
+    const std::uint64_t digest = image_digest(img);
+    FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1, .frame_freq = 0,
+                   .algorithm = Algorithm::DFS,
+                   .picker = StripePicker{RGBA{255, 0, 0}, RGBA{0, 0, 255}, 5}};
+    auto first = cache.fill(img, digest, cfg);
+    REQUIRE(cache.misses() == 1);
+    REQUIRE(cache.size() == 1);
+    REQUIRE(images_match(first.final_frame(), flood_fill(img, cfg).final_frame()));
+
+    // Another seed in the region and another picker: no traversal
+    const Point other = {0, 60};
+    REQUIRE(first.final_frame().at(0, 60) != img.at(0, 60));
+    cfg.seed   = other;
+    cfg.picker = SolidPicker{RGBA{0, 255, 0}};
+    auto hit = cache.fill(img, digest, cfg);
+    REQUIRE(cache.hits() == 1);
+    REQUIRE(hit.stats().filled_pixels == first.stats().filled_pixels);
+    REQUIRE(images_match(hit.final_frame(), flood_fill(img, cfg).final_frame()));
+
+    // Frames, other tolerances and connectivities traverse
+    cfg.frame_freq = 100;
+    auto framed = cache.fill(img, digest, cfg);
+    REQUIRE(framed.size() == flood_fill(img, cfg).size());
+    cfg.frame_freq   = 0;
+    cfg.connectivity = Connectivity::Eight;
+    cache.fill(img, digest, cfg);
+    cfg.tolerance = 0.2;
+    cache.fill(img, cfg);
+    REQUIRE(cache.hits() == 1);
+    REQUIRE(cache.misses() == 4);
+    REQUIRE(cache.size() == 3);
+
+    // A different image never hits
+    cfg.tolerance    = 0.1;
+    cfg.connectivity = Connectivity::Four;
+    auto changed_fill = cache.fill(changed, cfg);
+    REQUIRE(cache.misses() == 5);
+    REQUIRE(images_match(changed_fill.final_frame(),
+                         flood_fill(changed, cfg).final_frame()));
+
+    // Nor does one passed with a colliding digest: the size and sampled
+    // pixels are checked too
+    auto wall = img;
+    for (unsigned y = 0; y < wall.height(); ++y) wall.at(51, y) = RGBA{1, 2, 3};
+    const std::size_t misses = cache.misses();
+    REQUIRE(images_match(cache.fill(wall, digest, cfg).final_frame(),
+                         flood_fill(wall, cfg).final_frame()));
+    const auto wide = make_maze(98, 61);
+    REQUIRE(images_match(cache.fill(wide, digest, cfg).final_frame(),
+                         flood_fill(wide, cfg).final_frame()));
+    REQUIRE(cache.misses() == misses + 2);
+
+    // Room for two masks: the least recently used goes
+    const std::size_t mask_bytes = VisitedMap(97, 61).bytes();
+    FillCache small(2 * mask_bytes);
+    small.fill(img, digest, cfg);                                // A
+    cfg.tolerance = 0.2;
+    small.fill(img, digest, cfg);                                // B
+    cfg.tolerance = 0.1;
+    small.fill(img, digest, cfg);                                // A hit
+    cfg.connectivity = Connectivity::Eight;
+    small.fill(img, digest, cfg);                                // C evicts B
+    REQUIRE(small.size() == 2);
+    REQUIRE(small.bytes() == 2 * mask_bytes);
+    cfg.connectivity = Connectivity::Four;
+    small.fill(img, digest, cfg);
+    REQUIRE(small.hits() == 2);
+    cfg.tolerance = 0.2;
+    small.fill(img, digest, cfg);
+    REQUIRE(small.misses() == 4);
+}
+
+TEST_CASE("tolerance_map thresholds to flood_fill's region at every level",
+          "[fill][tolerance-map]") {
+    // Smooth gradients with a diagonal wall: many distinct distances and
+    // regions that grow around obstacles as the tolerance rises
+    Image img(83, 67);
+    for (unsigned y = 0; y < img.height(); ++y)
+        for (unsigned x = 0; x < img.width(); ++x)
+            img.at(x, y) = x == y + 10 ? RGBA{250, 250, 250}
+                                       : RGBA{static_cast<std::uint8_t>(x * 3),
+                                              static_cast<std::uint8_t>(y * 2),
+                                              static_cast<std::uint8_t>((x * y) % 61)};
+
+    for (auto conn : {Connectivity::Four, Connectivity::Eight}) {
+        const Point seed{40, 20};
+        const auto map = tolerance_map(img, seed, conn);
+        REQUIRE(map.level(40, 20) == 0);
+
+        for (double t : {0.0, 0.01, 0.05, 0.1, 0.2, 0.35, 0.6, 1.5}) {
+            const double exact = ToleranceMap::tolerance_of(
+                static_cast<unsigned>(ToleranceMap::level_for(t)));
+            REQUIRE(exact <= t);
+            REQUIRE(t - exact < ToleranceMap::step);
+
+            FillConfig cfg{.seed = seed, .tolerance = exact, .frame_freq = 0,
+                           .algorithm = Algorithm::Scanline,
+                           .picker = StripePicker{RGBA{255, 0, 0},
+                                                  RGBA{0, 0, 255}, 3},
+                           .connectivity = conn};
+            const auto sel    = flood_select(img, cfg, true);
+            const auto region = map.region(t);
+            REQUIRE(map.count(t) == sel.pixel_count);
+            for (int y = 0; y < static_cast<int>(img.height()); ++y)
+                for (int x = 0; x < static_cast<int>(img.width()); ++x)
+                    REQUIRE(region.test(x, y) == sel.mask->test(x, y));
+
+            REQUIRE(images_match(map.fill(img, cfg).final_frame(),
+                                 flood_fill(img, cfg).final_frame()));
+        }
+    }
+
+    REQUIRE(tolerance_map(img, {-1, 0}).empty());
+    REQUIRE(ToleranceMap::level_for(-0.1) == -1);
+
+    // Below every level only the seed is filled, as flood_fill paints it
+    const auto map = tolerance_map(img, {1, 1});
+    FillConfig cfg{.seed = {1, 1}, .tolerance = -1, .frame_freq = 0};
+    for (double t : {-1.0, std::numeric_limits<double>::quiet_NaN()}) {
+        REQUIRE(map.count(t) == 1);
+        const auto region = map.region(t);
+        REQUIRE(region.test(1, 1));
+        REQUIRE_FALSE(region.test(2, 1));
+    }
+    REQUIRE(images_match(map.fill(img, cfg).final_frame(),
+                         flood_fill(img, cfg).final_frame()));
+    REQUIRE(count_changed(img, map.fill(img, cfg).final_frame()) == 1);
+}
+
+TEST_CASE("Fills follow the configured colour metric", "[fill][metric]") {
+    // A gradient where the metrics disagree about which pixels are close
+    Image img(91, 73);
+    for (unsigned y = 0; y < img.height(); ++y)
+        for (unsigned x = 0; x < img.width(); ++x)
+            img.at(x, y) = RGBA{static_cast<std::uint8_t>(x * 2),
+                                static_cast<std::uint8_t>(y * 3),
+                                static_cast<std::uint8_t>(x + y),
+                                static_cast<std::uint8_t>(255 - x)};
+
+    const Point seed{45, 36};
+    const RGBA  seed_color = img.at(45, 36);
+    const struct { ColorMetric metric; double tolerance; } cases[] = {
+        {ColorMetric::Hsl, 0.2},        {ColorMetric::Rgb, 0.25},
+        {ColorMetric::MaxChannel, 0.2}, {ColorMetric::PremultipliedRgb, 0.05},
+        {ColorMetric::Lab, 20.0}};
+    std::vector<FillConfig> batch;
+    for (const auto& c : cases) {
+        FillConfig cfg{.seed = seed, .tolerance = c.tolerance, .frame_freq = 0,
+                       .metric = c.metric};
+
+        // Reference: BFS over color_distance(..., metric)
+        VisitedMap ref(img.width(), img.height());
+        std::vector<Point> queue{seed};
+        ref.set(seed.x, seed.y);
+        for (std::size_t i = 0; i < queue.size(); ++i) {
+            const Point p = queue[i];
+            for (Point q : {Point{p.x + 1, p.y}, Point{p.x - 1, p.y},
+                            Point{p.x, p.y + 1}, Point{p.x, p.y - 1}}) {
+                if (q.x < 0 || q.y < 0 || q.x >= 91 || q.y >= 73 ||
+                    ref.test(q.x, q.y))
+                    continue;
+                if (color_distance(seed_color,
+                                   img.at(static_cast<unsigned>(q.x),
+                                          static_cast<unsigned>(q.y)),
+                                   c.metric) > c.tolerance)
+                    continue;
+                ref.set(q.x, q.y);
+                queue.push_back(q);
+            }
+        }
+        INFO("metric " << static_cast<int>(c.metric));
+        REQUIRE(queue.size() > 50);
+        REQUIRE(queue.size() < img.pixel_count());
+
+        const auto sel = flood_select(img, cfg, true);
+        REQUIRE(sel.pixel_count == queue.size());
+        for (int y = 0; y < 73; ++y)
+            for (int x = 0; x < 91; ++x)
+                REQUIRE(sel.mask->test(x, y) == ref.test(x, y));
+
+        auto bfs = flood_fill(img, cfg);
+        REQUIRE(bfs.stats().filled_pixels == queue.size());
+        for (auto algo : {Algorithm::Scanline, Algorithm::Parallel}) {
+            cfg.algorithm = algo;
+            REQUIRE(images_match(flood_fill(img, cfg).final_frame(),
+                                 bfs.final_frame()));
+        }
+        batch.push_back(cfg);
+    }
+
+    // Regions cached for one metric are not reused for another
+    auto many = flood_fill_many(img, batch);
+    for (std::size_t i = 0; i < batch.size(); ++i)
+        REQUIRE(images_match(many[i].final_frame(),
+                             flood_fill(img, batch[i]).final_frame()));
+}
+
+TEST_CASE("PreparedImage fills match flood_fill", "[fill][prepared]") {
+    Image img(131, 77, Layout::Tiled);
+    for (unsigned y = 0; y < img.height(); ++y)
+        for (unsigned x = 0; x < img.width(); ++x)
+            img.at(x, y) = x == y + 20 ? RGBA{0, 0, 0}
+                                       : RGBA{static_cast<std::uint8_t>(x * 2),
+                                              static_cast<std::uint8_t>(y * 3),
+                                              static_cast<std::uint8_t>(x + y)};
+
+    const PreparedImage prepared(img, 3);
+    REQUIRE(prepared.image() == img);
+    REQUIRE(prepared.image().layout() == Layout::RowMajor);
+    REQUIRE(prepared.stride() % (PreparedImage::alignment / sizeof(float)) == 0);
+    REQUIRE(reinterpret_cast<std::uintptr_t>(prepared.lightness(5)) %
+                PreparedImage::alignment == 0);
+    REQUIRE(prepared.hue(3)[7] ==
+            static_cast<float>(rgb_to_hsl(img.at(7, 3)).h / 360.0));
+
+    // Batched verdicts agree with color_distance at every pixel's distance
+    const RGBA seed = img.at(60, 30);
+    std::vector<std::uint64_t> bits(3);
+    for (unsigned x = 0; x < img.width(); x += 13) {
+        const double tol = color_distance(seed, img.at(x, 40));
+        for (double t : {tol, std::nextafter(tol, 0.0)}) {
+            std::fill(bits.begin(), bits.end(), 0);
+            prepared.within(0, 40, img.width(), seed, t, bits.data());
+            for (unsigned i = 0; i < img.width(); ++i)
+                REQUIRE((((bits[i >> 6] >> (i & 63)) & 1u) != 0) ==
+                        (color_distance(seed, img.at(i, 40)) <= t));
+        }
+    }
+
+    for (double t : {0.0, 0.05, 0.2, 0.6}) {
+        for (auto algo : {Algorithm::BFS, Algorithm::Scanline,
+                          Algorithm::Parallel}) {
+            FillConfig cfg{.seed = {60, 30}, .tolerance = t, .frame_freq = 500,
+                           .algorithm = algo};
+            auto direct = flood_fill(img, cfg);
+            auto fast   = flood_fill(prepared, cfg);
+            REQUIRE(fast.stats().filled_pixels == direct.stats().filled_pixels);
+            REQUIRE(fast.size() == direct.size());
+            REQUIRE(fast.final_frame() == direct.final_frame());
+        }
+    }
+
+    // Other metrics fill the pixel copy
+    FillConfig rgb{.seed = {60, 30}, .tolerance = 0.2, .frame_freq = 0,
+                   .metric = ColorMetric::Rgb};
+    REQUIRE(flood_fill(prepared, rgb).final_frame() ==
+            flood_fill(img, rgb).final_frame());
+    REQUIRE(flood_fill(prepared, FillConfig{.seed = {-1, 0}}).size() == 0);
+}
+
+TEST_CASE("Animation stores frame deltas and rebuilds any frame",
+          "[fill][animation]") {
+    auto img = make_maze(150, 97);
+    for (auto layout : {Layout::RowMajor, Layout::Tiled}) {
+        const Image src = img.converted(layout);
+        for (auto algo : {Algorithm::BFS, Algorithm::Scanline}) {
+            FillConfig cfg{.seed = {1, 2}, .tolerance = 0.1, .frame_freq = 97,
+                           .algorithm = algo,
+                           .picker = StripePicker{RGBA{255, 0, 0},
+                                                  RGBA{0, 0, 255}, 3}};
+            std::vector<Image> ref;
+            for (const Image& frame : flood_fill_frames(src, cfg))
+                ref.push_back(frame);
+
+            auto anim = flood_fill(src, cfg);
+            REQUIRE(anim.size() == ref.size());
+            REQUIRE(anim.size() > 20);
+            REQUIRE(anim.keyframes() > 1);
+            // The final frame whole, keyframes as padded 64x64 tiles, then
+            // a few bytes a pixel
+            REQUIRE(anim.bytes() < 5 * src.pixel_count() * sizeof(RGBA));
+
+            // Backwards, forwards, and jumping around
+            for (std::size_t i = anim.size(); i-- > 0;)
+                REQUIRE(anim.frame(i) == ref[i]);
+            for (std::size_t i = 0; i < anim.size(); ++i)
+                REQUIRE(anim.frame(i) == ref[i]);
+            for (std::size_t i = 0; i < anim.size(); i += 7)
+                REQUIRE(anim.frame((i * 13) % anim.size()) ==
+                        ref[(i * 13) % anim.size()]);
+            REQUIRE(anim.frame(0).layout() == layout);
+            REQUIRE_THROWS_AS(anim.frame(anim.size()), std::out_of_range);
+        }
+    }
+
+    // Frames added whole are diffed; once the changes since the last
+    // keyframe outnumber a quarter of the pixels, a new keyframe starts
+    Animation anim;
+    const Image black = make_solid(8, 8, RGBA{0, 0, 0});
+    const Image white = make_solid(8, 8, RGBA{255, 255, 255});
+    anim.add_frame(black);
+    anim.add_frame(white);
+    anim.add_frame(black);
+    REQUIRE(anim.keyframes() == 3);
+    Image grey = white;
+    grey.at(3, 4) = RGBA{128, 128, 128};
+    const std::uint32_t changed[] = {3 + 4 * 8};
+    anim.add_frame(white);
+    anim.add_frame(grey, changed);
+    REQUIRE(anim.size() == 5);
+    REQUIRE(anim.keyframes() == 4);
+    REQUIRE(anim.final_frame() == grey);
+    REQUIRE(anim.frame(3) == white);
+    REQUIRE(anim.frame(2) == black);
+    REQUIRE(anim.frame(1) == white);
+    REQUIRE(anim.frame(0) == black);
+    REQUIRE_THROWS_AS(anim.add_frame(make_solid(4, 4, RGBA{})),
+                      std::runtime_error);
+}
+
+TEST_CASE("TileCanvas copies share tiles until written",
+          "[animation]") {
+    Image img(150, 97, Layout::RowMajor);
+    for (unsigned y = 0; y < img.height(); ++y)
+        for (unsigned x = 0; x < img.width(); ++x)
+            img.at(x, y) = RGBA{static_cast<std::uint8_t>(x),
+                                static_cast<std::uint8_t>(y), 7};
+
+    TileCanvas canvas(img);
+    REQUIRE(canvas.tile_count() == 3 * 2);
+    REQUIRE(canvas.shared_tiles() == 0);
+    REQUIRE(canvas.to_image() == img);
+    REQUIRE(canvas.to_image(Layout::Tiled) == img);
+
+    const TileCanvas snapshot = canvas;
+    REQUIRE(canvas.shared_tiles() == 6);
+
+    // Writing duplicates only the written tile; the snapshot keeps the old
+    // pixels, by coordinates or by either layout's storage offset
+    canvas.write(130, 70) = RGBA{1, 2, 3};
+    REQUIRE(canvas.shared_tiles() == 5);
+    REQUIRE(snapshot.at(130, 70) == img.at(130, 70));
+    const Image tiled = img.converted(Layout::Tiled);
+    canvas.write(static_cast<std::size_t>(&tiled.at(5, 90) - tiled.data()),
+                 Layout::Tiled) = RGBA{4, 5, 6};
+    canvas.write(std::size_t{20} * 150 + 149, Layout::RowMajor) =
+        RGBA{8, 9, 10};
+    REQUIRE(canvas.shared_tiles() == 3);
+
+    Image expect = img;
+    expect.at(130, 70) = RGBA{1, 2, 3};
+    expect.at(5, 90)   = RGBA{4, 5, 6};
+    expect.at(149, 20) = RGBA{8, 9, 10};
+    Image out(150, 97, Layout::Tiled);
+    canvas.copy_to(out);
+    REQUIRE(out == expect);
+    REQUIRE(snapshot.to_image() == img);
+}
+
+TEST_CASE("max_animation_bytes keeps frames spanning the whole fill",
+          "[fill][animation][limits]") {
+    const auto img = make_solid(300, 200, RGBA{10, 10, 10});
+    for (auto algo : {Algorithm::BFS, Algorithm::Scanline}) {
+        FillConfig cfg{.seed = {3, 4}, .tolerance = 0.1, .frame_freq = 250,
+                       .algorithm = algo,
+                       .picker = StripePicker{RGBA{255, 0, 0},
+                                              RGBA{0, 0, 255}, 3}};
+        const auto all = flood_fill(img, cfg);
+        const std::size_t budget = 1'500'000;
+        REQUIRE(all.bytes() > budget);
+        REQUIRE(estimate_fill_memory(300, 200, cfg) >=
+                all.bytes() + img.pixel_count() * sizeof(RGBA));
+
+        cfg.max_animation_bytes = budget;
+        const auto thinned = flood_fill(img, cfg);
+        REQUIRE(thinned.bytes() <= budget); // before frame() adds its cursor
+        REQUIRE(thinned.stats().frames_captured == thinned.size());
+        REQUIRE(thinned.final_frame() == all.final_frame());
+
+        // Frames at every (2^t)-th capture, up to the end of the fill
+        const std::size_t captures = all.size() - 1;
+        std::size_t stride = 2;
+        while ((captures / stride) > thinned.size() - 1) stride *= 2;
+        REQUIRE(captures / stride == thinned.size() - 1);
+        REQUIRE(thinned.size() > 4);
+        for (std::size_t i = 0; i + 1 < thinned.size(); ++i)
+            REQUIRE(thinned.frame(i) == all.frame((i + 1) * stride - 1));
+        REQUIRE(thinned.bytes() < all.bytes());
+        REQUIRE(estimate_fill_memory(300, 200, cfg) <
+                estimate_fill_memory(300, 200, FillConfig{.frame_freq = 250}));
+    }
+
+    // A budget under the floor, the latest frame and two tiled copies, is
+    // raised to it rather than dropping every frame but the last
+    const std::size_t floor =
+        img.pixel_count() * sizeof(RGBA) + 2 * 20 * TileCanvas::tile_bytes;
+    for (auto algo : {Algorithm::BFS, Algorithm::DFS, Algorithm::Scanline}) {
+        const FillConfig cfg{.seed = {3, 4}, .tolerance = 0.1,
+                             .frame_freq = 250, .algorithm = algo,
+                             .max_animation_bytes = 1000};
+        const auto anim = flood_fill(img, cfg);
+        REQUIRE(anim.bytes() <= floor);
+        REQUIRE(anim.size() > 1);
+        REQUIRE(anim.stats().frames_captured == anim.size());
+    }
+
+    // Final frame only: the canvas and scratch
+    const std::size_t final_only =
+        estimate_fill_memory(300, 200, FillConfig{.frame_freq = 0});
+    REQUIRE(final_only >= img.pixel_count() * sizeof(RGBA));
+    REQUIRE(final_only <
+            estimate_fill_memory(300, 200, FillConfig{.frame_freq = 250}));
+    REQUIRE(estimate_fill_memory(300, 200, FillConfig{
+                .frame_freq = 0, .algorithm = Algorithm::Parallel}) ==
+            final_only + img.pixel_count() * sizeof(std::uint32_t));
+}
+
+TEST_CASE("Animation::thin drops every other frame", "[animation]") {
+    std::vector<Image> frames;
+    for (unsigned i = 0; i < 9; ++i) {
+        Image f = make_solid(8, 8, RGBA{0, 0, 0});
+        // Up to a whole image changes, so some frames are keyframes
+        for (unsigned p = 0; p < (i % 3 ? i : 64); ++p)
+            f.at(p % 8, p / 8) = RGBA{static_cast<std::uint8_t>(i * 20), 1, 2};
+        frames.push_back(f);
+    }
+    Animation single;
+    single.add_frame(frames[0]);
+    REQUIRE_FALSE(single.thin());
+
+    for (std::size_t n : {9, 8, 3, 2}) {
+        Animation anim;
+        for (std::size_t i = 0; i < n; ++i) anim.add_frame(frames[i]);
+        if (n > 3) REQUIRE(anim.keyframes() > 1);
+
+        // Only when it saves memory, if asked
+        Animation copy = anim;
+        const std::size_t before = copy.bytes();
+        if (copy.thin(true))
+            REQUIRE(copy.bytes() < before);
+        else
+            REQUIRE(copy.size() == n);
+
+        REQUIRE(anim.thin());
+        REQUIRE(anim.size() == n / 2 + n % 2);
+        for (std::size_t i = 0; i < n / 2; ++i)
+            REQUIRE(anim.frame(i) == frames[2 * i + 1]);
+        REQUIRE(anim.final_frame() == frames[n - 1]);
+        REQUIRE(anim.frame(anim.size() - 1) == frames[n - 1]);
+
+        // The latest frame still takes changes
+        anim.add_frame(frames[0]);
+        REQUIRE(anim.frame(anim.size() - 1) == frames[0]);
+        REQUIRE(anim.frame(0) == frames[1]);
+    }
+}
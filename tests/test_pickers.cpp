@@ -7,6 +7,12 @@
 #include "triplefill/pickers/solid.hpp"
 #include "triplefill/pickers/stripe.hpp"
 #include "triplefill/tolerance.hpp"
+#include "triplefill/tolerance_mask.hpp"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <vector>
 
 using namespace triplefill;
 
@@ -90,24 +96,72 @@ TEST_CASE("QuarterPicker varies by quadrant", "[pickers][quarter]") {
 TEST_CASE("BorderPicker returns border colour near unfilled neighbours",
           "[pickers][border]") {
     const unsigned W = 10, H = 10;
-    std::vector<uint8_t> visited(W * H, 0);
+    VisitedMap visited(W, H);
     // Fill a 5x5 block in the centre
-    for (unsigned y = 3; y < 8; ++y)
-        for (unsigned x = 3; x < 8; ++x)
-            visited[y * W + x] = 1;
+    for (int y = 3; y < 8; ++y)
+        visited.set_run(y, 3, 7);
 
     BorderPicker bp{RGBA{0, 255, 0}, RGBA{255, 0, 0}, 1};
 
     SECTION("interior pixel returns fill colour") {
-        REQUIRE(pick_border(bp, visited, W, H, {5, 5}, RGBA{}) ==
+        REQUIRE(pick_border(bp, visited, {5, 5}, RGBA{}) ==
                 RGBA{0, 255, 0});
     }
     SECTION("edge pixel returns border colour") {
-        REQUIRE(pick_border(bp, visited, W, H, {3, 5}, RGBA{}) ==
+        REQUIRE(pick_border(bp, visited, {3, 5}, RGBA{}) ==
                 RGBA{255, 0, 0});
     }
 }
 
+TEST_CASE("BorderPicker treats the image edge as unfilled",
+          "[pickers][border]") {
+    VisitedMap visited(4, 4);
+    for (int y = 0; y < 4; ++y)
+        visited.set_run(y, 0, 3);
+
+    BorderPicker bp{RGBA{0, 255, 0}, RGBA{255, 0, 0}, 2};
+    REQUIRE(pick_border(bp, visited, {0, 2}, RGBA{}) == RGBA{255, 0, 0});
+    REQUIRE(pick_border(bp, visited, {1, 2}, RGBA{}) == RGBA{255, 0, 0});
+    REQUIRE(pick_border(bp, visited, {2, 2}, RGBA{}) == RGBA{255, 0, 0});
+
+    BorderPicker thin{RGBA{0, 255, 0}, RGBA{255, 0, 0}, 1};
+    REQUIRE(pick_border(thin, visited, {1, 2}, RGBA{}) == RGBA{0, 255, 0});
+}
+
+// ---------------------------------------------------------------------------
+// VisitedMap
+// ---------------------------------------------------------------------------
+
+TEST_CASE("VisitedMap sentinel border and runs", "[visited]") {
+    VisitedMap v(130, 3);
+
+    SECTION("border reads as visited but not filled") {
+        REQUIRE(v.test(-1, 0));
+        REQUIRE(v.test(130, 2));
+        REQUIRE(v.test(64, -1));
+        REQUIRE(v.test(64, 3));
+        REQUIRE_FALSE(v.filled(-1, 0));
+        REQUIRE_FALSE(v.filled(64, 3));
+    }
+    SECTION("interior starts clear") {
+        for (int y = 0; y < 3; ++y)
+            for (int x = 0; x < 130; ++x)
+                REQUIRE_FALSE(v.test(x, y));
+    }
+    SECTION("set_run spanning several words marks exactly the run") {
+        v.set_run(1, 5, 120);
+        for (int x = 0; x < 130; ++x) {
+            REQUIRE(v.filled(x, 1) == (x >= 5 && x <= 120));
+            REQUIRE_FALSE(v.filled(x, 0));
+            REQUIRE_FALSE(v.filled(x, 2));
+        }
+    }
+    SECTION("neighbours are one stride apart") {
+        REQUIRE(v.index(7, 2) - v.index(7, 1) == v.stride());
+        REQUIRE(v.index(8, 1) - v.index(7, 1) == 1);
+    }
+}
+
 // ---------------------------------------------------------------------------
 // Tolerance
 // ---------------------------------------------------------------------------
@@ -131,3 +185,244 @@ TEST_CASE("HSL round-trip preserves colour", "[tolerance]") {
     REQUIRE(std::abs(static_cast<int>(orig.b) - back.b) <= 1);
     REQUIRE(back.a == orig.a);
 }
+
+// ---------------------------------------------------------------------------
+// ToleranceMask
+// ---------------------------------------------------------------------------
+
+TEST_CASE("ToleranceMask agrees exactly with color_distance",
+          "[tolerance][mask]") {
+    // 300 wide so each row has a full and a partial 256-pixel segment.
+    Image img(300, 7);
+    std::uint32_t state = 12345;
+    for (std::size_t i = 0; i < img.pixel_count(); ++i) {
+        state = state * 1664525u + 1013904223u;
+        img.data()[i] = RGBA{static_cast<std::uint8_t>(state >> 24),
+                             static_cast<std::uint8_t>(state >> 16),
+                             static_cast<std::uint8_t>(state >> 8)};
+    }
+    // Greys and primaries hit the achromatic and hue-branch edge cases.
+    for (unsigned x = 0; x < 256; ++x) {
+        const auto v = static_cast<std::uint8_t>(x);
+        img.at(x, 0) = RGBA{v, v, v};
+        img.at(x, 1) = RGBA{v, 0, 0};
+        img.at(x, 2) = RGBA{v, v, 0};
+    }
+
+    const RGBA seed{120, 80, 200};
+    std::vector<double> tolerances{0.0, 0.05, 0.1, 0.3, 0.6, 1.3};
+    // Thresholds that some pixels sit exactly on
+    for (std::size_t i = 0; i < img.pixel_count(); i += 97)
+        tolerances.push_back(color_distance(seed, img.data()[i]));
+
+    INFO("kernel: " << ToleranceMask::kernel_name());
+    for (double tol : tolerances) {
+        ToleranceMask mask(img, seed, tol);
+        for (unsigned y = 0; y < img.height(); ++y)
+            for (unsigned x = 0; x < img.width(); ++x)
+                REQUIRE(mask.test(x, y) ==
+                        (color_distance(seed, img.at(x, y)) <= tol));
+    }
+}
+
+TEST_CASE("color_within agrees exactly with color_distance at thresholds",
+          "[tolerance][batch]") {
+    // Boundary cases for the single-precision kernels:
+    //  - every grey (achromatic: hue and saturation forced to 0),
+    //  - ramps that tie max between channels (hue sector choice),
+    //  - hues either side of red (the wrap at 0 / 360 degrees),
+    //  - lightness near 0 and 1 (the saturation denominator's two halves),
+    //  - a coarse grid over the whole cube,
+    // each tested with tolerances exactly equal to some pixel's distance and
+    // one ulp either side, so any verdict decided in float near tolerance²
+    // would flip.
+    std::vector<RGBA> px;
+    for (int v = 0; v < 256; ++v) {
+        const auto c = static_cast<std::uint8_t>(v);
+        px.push_back({c, c, c});
+        px.push_back({c, c, 0});
+        px.push_back({255, c, c});
+        px.push_back({c, 255, c});
+        px.push_back({255, 0, c});
+        px.push_back({255, c, 0});
+        px.push_back({c, 1, 0});
+        px.push_back({254, 255, c});
+    }
+    for (int r = 0; r < 256; r += 15)
+        for (int g = 0; g < 256; g += 15)
+            for (int b = 0; b < 256; b += 15)
+                px.push_back({static_cast<std::uint8_t>(r),
+                              static_cast<std::uint8_t>(g),
+                              static_cast<std::uint8_t>(b)});
+
+    const RGBA seeds[] = {{120, 80, 200}, {128, 128, 128}, {255, 0, 1},
+                          {0, 0, 0},      {250, 252, 255}, {7, 77, 177}};
+    INFO("kernel: " << color_within_kernel());
+    for (const RGBA& seed : seeds) {
+        std::vector<double> dist(px.size());
+        for (std::size_t i = 0; i < px.size(); ++i)
+            dist[i] = color_distance(seed, px[i]);
+
+        std::vector<double> tolerances{-0.1, 0.0, 0.05, 0.3, 0.6, 1.5, 2.0};
+        for (std::size_t i = 0; i < px.size(); i += 37) {
+            tolerances.push_back(dist[i]);
+            tolerances.push_back(std::nextafter(dist[i], 0.0));
+            tolerances.push_back(std::nextafter(dist[i], 2.0));
+        }
+
+        std::vector<std::uint64_t> bits((px.size() + 63) / 64);
+        for (double tol : tolerances) {
+            std::fill(bits.begin(), bits.end(), 0);
+            color_within(px.data(), px.size(), seed, tol, bits.data());
+            std::size_t wrong = 0;
+            for (std::size_t i = 0; i < px.size(); ++i) {
+                const bool in = (bits[i >> 6] >> (i & 63)) & 1u;
+                wrong += in != (dist[i] <= tol);
+            }
+            INFO("seed " << int(seed.r) << "," << int(seed.g) << ","
+                         << int(seed.b) << " tolerance " << tol);
+            REQUIRE(wrong == 0);
+        }
+    }
+}
+
+TEST_CASE("color_within agrees exactly with color_distance for every metric",
+          "[tolerance][batch][metric]") {
+    // A grid over the cube at several alphas (only PremultipliedRgb reads
+    // alpha), tested at tolerances equal to some pixel's distance and one
+    // ulp either side.
+    std::vector<RGBA> px;
+    for (int a : {255, 254, 128, 1, 0})
+        for (int r = 0; r < 256; r += 17)
+            for (int g = 0; g < 256; g += 17)
+                for (int b = 0; b < 256; b += 51)
+                    px.push_back({static_cast<std::uint8_t>(r),
+                                  static_cast<std::uint8_t>(g),
+                                  static_cast<std::uint8_t>(b),
+                                  static_cast<std::uint8_t>(a)});
+
+    const RGBA seeds[] = {{120, 80, 200}, {0, 0, 0, 255}, {255, 255, 255, 0},
+                          {7, 77, 177, 128}};
+    INFO("kernel: " << color_within_kernel());
+    for (auto metric : {ColorMetric::Hsl, ColorMetric::Rgb,
+                        ColorMetric::MaxChannel, ColorMetric::PremultipliedRgb,
+                        ColorMetric::Lab}) {
+        for (const RGBA& seed : seeds) {
+            std::vector<double> dist(px.size());
+            for (std::size_t i = 0; i < px.size(); ++i)
+                dist[i] = color_distance(seed, px[i], metric);
+            REQUIRE(color_distance(seed, seed, metric) == 0);
+
+            std::vector<double> tolerances{-0.1, 0.0, 0.05, 0.5, 300.0};
+            for (std::size_t i = 0; i < px.size(); i += 29) {
+                tolerances.push_back(dist[i]);
+                tolerances.push_back(std::nextafter(dist[i], 0.0));
+                tolerances.push_back(std::nextafter(dist[i], 300.0));
+            }
+
+            std::vector<std::uint64_t> bits((px.size() + 63) / 64);
+            for (double tol : tolerances) {
+                std::fill(bits.begin(), bits.end(), 0);
+                color_within(px.data(), px.size(), seed, tol, bits.data(),
+                             metric);
+                std::size_t wrong = 0;
+                for (std::size_t i = 0; i < px.size(); ++i) {
+                    const bool in = (bits[i >> 6] >> (i & 63)) & 1u;
+                    wrong += in != (dist[i] <= tol);
+                }
+                INFO("metric " << static_cast<int>(metric) << " seed "
+                               << int(seed.r) << "," << int(seed.g) << ","
+                               << int(seed.b) << "," << int(seed.a)
+                               << " tolerance " << tol);
+                REQUIRE(wrong == 0);
+            }
+        }
+    }
+
+    // Known values
+    const RGBA black{0, 0, 0}, white{255, 255, 255}, red{255, 0, 0};
+    REQUIRE(color_distance(black, white, ColorMetric::Hsl) ==
+            color_distance(black, white));
+    REQUIRE(color_distance(black, white, ColorMetric::Rgb) ==
+            Approx(std::sqrt(3.0)));
+    REQUIRE(color_distance(black, red, ColorMetric::MaxChannel) == 1.0);
+    REQUIRE(color_distance(black, white, ColorMetric::PremultipliedRgb) ==
+            Approx(3.0));
+    REQUIRE(color_distance(white, RGBA{255, 255, 255, 0},
+                           ColorMetric::PremultipliedRgb) == Approx(3.0));
+    REQUIRE(color_distance(black, white, ColorMetric::Lab) ==
+            Approx(100.0).epsilon(1e-4));
+    // Alpha only matters to PremultipliedRgb
+    REQUIRE(color_distance(red, RGBA{255, 0, 0, 0}, ColorMetric::Rgb) == 0);
+}
+
+TEST_CASE("ToleranceMask memoises verdicts per colour across masks",
+          "[tolerance][mask]") {
+    // Eight colours repeated over an image large enough for the memo
+    const RGBA palette[] = {{7, 77, 177},  {8, 77, 177},   {60, 77, 177},
+                            {200, 10, 10}, {0, 0, 0},      {255, 255, 255},
+                            {7, 177, 77},  {30, 90, 160}};
+    Image img(1024, 1024);
+    for (std::size_t i = 0; i < img.pixel_count(); ++i)
+        img.data()[i] = palette[(i * 5 + i / 1024) % 8];
+
+    const RGBA   seed{7, 77, 177};
+    const double tol = 0.08;
+    auto check = [&](ToleranceMask& mask) {
+        std::size_t wrong = 0;
+        for (unsigned y = 0; y < img.height(); ++y)
+            for (unsigned x = 0; x < img.width(); ++x)
+                wrong += mask.test(x, y) !=
+                         (color_distance(seed, img.at(x, y)) <= tol);
+        REQUIRE(wrong == 0);
+    };
+
+    const std::size_t tables = ToleranceMask::memo_tables();
+    {
+        ToleranceMask first(img, seed, tol);
+        REQUIRE(ToleranceMask::memo_tables() == tables); // allocated on a miss
+        check(first);
+        REQUIRE(ToleranceMask::memo_tables() == tables + 1);
+        REQUIRE(first.memo_lookups() == img.pixel_count());
+        // Colours are recorded after each segment, so only the first row's
+        // segments miss
+        REQUIRE(first.memo_hits() >= img.pixel_count() - img.width());
+
+        // A second mask with the same seed colour and tolerance starts warm
+        ToleranceMask second(img, seed, tol);
+        check(second);
+        REQUIRE(second.memo_hits() == img.pixel_count());
+        REQUIRE(ToleranceMask::memo_tables() == tables + 1);
+    }
+    // Freed with the last mask using it
+    REQUIRE(ToleranceMask::memo_tables() == tables);
+
+    // A small image is cheaper to evaluate than the table is to hold
+    Image small(300, 9);
+    for (std::size_t i = 0; i < small.pixel_count(); ++i)
+        small.data()[i] = palette[i % 8];
+    ToleranceMask direct(small, seed, tol);
+    direct.evaluate_all();
+    REQUIRE(direct.memo_lookups() == 0);
+    REQUIRE(ToleranceMask::memo_tables() == tables);
+
+    // Hardly any repeats: the mask stops consulting the table
+    Image noise(1024, 1024);
+    std::uint32_t state = 777;
+    for (std::size_t i = 0; i < noise.pixel_count(); ++i) {
+        state = state * 1664525u + 1013904223u;
+        noise.data()[i] = RGBA{static_cast<std::uint8_t>(state >> 24),
+                               static_cast<std::uint8_t>(state >> 16),
+                               static_cast<std::uint8_t>(state >> 8)};
+    }
+    ToleranceMask sparse(noise, RGBA{1, 2, 3}, 0.3);
+    sparse.evaluate_all();
+    REQUIRE(sparse.memo_lookups() > 0);
+    REQUIRE(sparse.memo_lookups() < noise.pixel_count());
+    std::size_t wrong = 0;
+    for (unsigned y = 0; y < noise.height(); ++y)
+        for (unsigned x = 0; x < noise.width(); ++x)
+            wrong += sparse.test(x, y) !=
+                     (color_distance(RGBA{1, 2, 3}, noise.at(x, y)) <= 0.3);
+    REQUIRE(wrong == 0);
+}
@@ -2,14 +2,23 @@
 //
 // maxFrames/frameFreq contract (authoritative):
 //   frameFreq == 0  → final-only (1 frame, no intermediates)
-//   maxFrames == 0  → unlimited intermediate frames (clamped by memory estimate)
+//   maxFrames == 0  → unlimited intermediate frames (within ANIMATION_BUDGET_BYTES)
 //   maxFrames > 0   → cap intermediate frames to that number; final always appended
+//
+// Optional fill message fields: timeoutMs and maxPixels (0 = no limit) stop
+// a runaway fill early. Post { type: "cancel" } to stop a streaming
+// final-only fill; its result then reports stats.stopReason "cancelled".
 "use strict";
 
 var wasmModule = null;
 
-// 256 MB budget for frame storage (tunable)
-var SAFE_LIMIT_BYTES = 256 * 1024 * 1024;
+// Budget for frame storage (tunable). Passed to fill_create as
+// max_animation_bytes: the library merges frames to stay within it, raised
+// to the few bytes per pixel the first and final frames need.
+var ANIMATION_BUDGET_BYTES = 256 * 1024 * 1024;
+
+// Pixels painted between progress messages in final-only fills
+var STREAM_STEP_PIXELS = 1 << 16;
 
 var ERROR_CODES = {
   "-1": "Invalid arguments",
@@ -42,6 +51,103 @@ function loadModule() {
   });
 }
 
+var STOP_REASONS = ["complete", "cancelled", "deadline", "pixel budget"];
+
+// Session of the final-only fill in progress, so a "cancel" message (or a
+// newer "fill") can stop it between steps.
+var activeSession = null;
+
+function cancelActive() {
+  if (activeSession) activeSession.m._fill_session_cancel(activeSession.handle);
+}
+
+// Final-only fill stepped through a FillSession. Yields to the event loop
+// between steps, so cancel messages are seen, and posts a "progress" message
+// with the changed rectangle after each step. Resolves to the final frame.
+function streamFill(m, inPtr, ppPtr, ppLen, msg) {
+  var width = msg.width;
+  var height = msg.height;
+  var handle = m._fill_session_create(
+    inPtr,
+    width,
+    height,
+    msg.seedX,
+    msg.seedY,
+    msg.tolerance,
+    msg.algo,
+    msg.picker,
+    ppPtr,
+    ppLen,
+    msg.timeoutMs || 0,
+    msg.maxPixels || 0
+  );
+  if (!handle) throw new Error(getWasmErrorMessage(m) || describeError(-5));
+
+  var session = { m: m, handle: handle };
+  activeSession = session;
+  var rectPtr = m._malloc(16);
+
+  function cleanup() {
+    m._free(rectPtr);
+    m._fill_session_destroy(handle);
+    if (activeSession === session) activeSession = null;
+  }
+
+  return new Promise(function (resolve, reject) {
+    function pump() {
+      try {
+        var rc = m._fill_session_step(handle, STREAM_STEP_PIXELS);
+        if (rc < 0)
+          throw new Error(getWasmErrorMessage(m) || describeError(-5));
+
+        m._fill_session_dirty(handle, rectPtr);
+        var x0 = m.getValue(rectPtr, "i32");
+        var y0 = m.getValue(rectPtr + 4, "i32");
+        var x1 = m.getValue(rectPtr + 8, "i32");
+        var y1 = m.getValue(rectPtr + 12, "i32");
+        // The canvas may move if the WASM heap grows, so re-read it each step
+        var canvasPtr = m._fill_session_canvas(handle);
+        if (x0 < x1 && y0 < y1) {
+          var rw = x1 - x0;
+          var rect = new Uint8Array(rw * (y1 - y0) * 4);
+          for (var y = y0; y < y1; y++) {
+            var src = canvasPtr + (y * width + x0) * 4;
+            rect.set(m.HEAPU8.subarray(src, src + rw * 4), (y - y0) * rw * 4);
+          }
+          self.postMessage(
+            {
+              type: "progress",
+              x: x0,
+              y: y0,
+              width: rw,
+              height: y1 - y0,
+              rgba: rect.buffer,
+            },
+            [rect.buffer]
+          );
+        }
+
+        if (rc === 1) {
+          var result = {
+            frame: m.HEAPU8.slice(canvasPtr, canvasPtr + width * height * 4)
+              .buffer,
+            filledPixels: m._fill_session_filled_pixels(handle),
+            stopReason: m._fill_session_stop_reason(handle),
+          };
+          cleanup();
+          resolve(result);
+          return;
+        }
+        setTimeout(pump, 0);
+      } catch (err) {
+        cleanup();
+        reject(err);
+      }
+    }
+    pump();
+  });
+}
+
 function getWasmErrorMessage(m) {
   if (typeof m._fill_last_error_code !== "function") return null;
   var code = m._fill_last_error_code();
@@ -62,7 +168,13 @@ function getWasmErrorMessage(m) {
 
 self.onmessage = function (e) {
   var msg = e.data;
+  if (msg.type === "cancel") {
+    cancelActive();
+    return;
+  }
   if (msg.type !== "fill") return;
+  // A newer fill supersedes one still streaming
+  cancelActive();
 
   var t0 = performance.now();
 
@@ -71,49 +183,21 @@ self.onmessage = function (e) {
       var width = msg.width;
       var height = msg.height;
       var pixelBytes = width * height * 4;
-      var bytesPerFrame = pixelBytes;
       var warnings = [];
 
-      // ---- Preflight memory estimate + auto-clamp ----
+      // ---- Preflight memory estimate ----
       var wantFrames = msg.frameFreq > 0;
-      var requestedMaxFrames = msg.maxFrames;
-      var effectiveMaxFrames = requestedMaxFrames;
-
-      if (wantFrames) {
-        if (requestedMaxFrames === 0) {
-          // Unlimited → clamp to safe memory budget
-          var clamp = Math.floor(SAFE_LIMIT_BYTES / bytesPerFrame) - 1;
-          effectiveMaxFrames = Math.max(1, clamp);
-          if (clamp <= 0) {
-            wantFrames = false;
-            warnings.push(
-              "Image too large for frame capture (" +
-                Math.round(bytesPerFrame / 1024) +
-                " KB/frame). Showing final image only."
-            );
-          }
-        } else {
-          var estimatedBytes = bytesPerFrame * (requestedMaxFrames + 1);
-          if (estimatedBytes > SAFE_LIMIT_BYTES) {
-            var clampedMax = Math.max(
-              1,
-              Math.floor(SAFE_LIMIT_BYTES / bytesPerFrame) - 1
-            );
-            effectiveMaxFrames = Math.min(requestedMaxFrames, clampedMax);
-            warnings.push(
-              "Reduced max frames from " +
-                requestedMaxFrames +
-                " to " +
-                effectiveMaxFrames +
-                " to stay within memory limits."
-            );
-          }
-        }
-      }
-
-      var estimatedBytes = wantFrames
-        ? bytesPerFrame * (effectiveMaxFrames + 1)
-        : bytesPerFrame;
+      var budgetBytes = wantFrames ? ANIMATION_BUDGET_BYTES : 0;
+      var estimatedBytes = m._fill_estimate_memory(
+        width,
+        height,
+        wantFrames ? msg.frameFreq : 0,
+        msg.algo,
+        msg.maxFrames,
+        budgetBytes
+      );
+      if (estimatedBytes < 0)
+        throw new Error(getWasmErrorMessage(m) || describeError(-1));
 
       // ---- Allocate input ----
       var inPtr = m._malloc(pixelBytes);
@@ -132,7 +216,9 @@ self.onmessage = function (e) {
       var frames = [];
       var frameCount = 0;
       var filledPixels = 0;
+      var stopReason = 0;
       var status = "ok";
+      var pending = null;
 
       if (wantFrames) {
         var handle = m._fill_create(
@@ -147,7 +233,10 @@ self.onmessage = function (e) {
           msg.picker,
           ppPtr,
           ppLen,
-          effectiveMaxFrames
+          msg.maxFrames,
+          msg.timeoutMs || 0,
+          msg.maxPixels || 0,
+          budgetBytes
         );
 
         if (!handle) {
@@ -189,6 +278,9 @@ self.onmessage = function (e) {
           if (typeof m._fill_get_filled_pixels === "function") {
             filledPixels = m._fill_get_filled_pixels(handle);
           }
+          if (typeof m._fill_get_stop_reason === "function") {
+            stopReason = m._fill_get_stop_reason(handle);
+          }
           frameCount = m._fill_frame_count(handle);
           for (var i = 0; i < frameCount; i++) {
             var framePtr = m._fill_get_frame(handle, i);
@@ -201,6 +293,16 @@ self.onmessage = function (e) {
           m._fill_destroy(handle);
           frameCount = frames.length;
         }
+      } else if (typeof m._fill_session_create === "function") {
+        // Final-only path, streamed
+        pending = streamFill(m, inPtr, ppPtr, ppLen, msg).then(
+          function (streamed) {
+            frames = [streamed.frame];
+            frameCount = 1;
+            filledPixels = streamed.filledPixels;
+            stopReason = streamed.stopReason;
+          }
+        );
       } else {
         // Final-only path
         var outPtrPtr = m._malloc(4);
@@ -229,35 +331,45 @@ self.onmessage = function (e) {
         m._free(outSizePtr);
       }
 
-      m._free(inPtr);
-      m._free(ppPtr);
-
-      var elapsed = performance.now() - t0;
-      self.postMessage(
-        {
-          type: "result",
-          frames: frames,
-          width: width,
-          height: height,
-          frameCount: frameCount,
-          timeMs: Math.round(elapsed),
-          status: status,
-          warning: warnings.length > 0 ? warnings.join(" ") : undefined,
-          memory: {
-            bytesPerFrame: bytesPerFrame,
-            safeLimitBytes: SAFE_LIMIT_BYTES,
-            requestedMaxFrames: requestedMaxFrames,
-            effectiveMaxFrames: effectiveMaxFrames,
-            estimatedBytes: estimatedBytes,
-          },
-          stats: {
-            framesCaptured: frameCount,
-            filledPixels: filledPixels,
-            algo: msg.algo === 1 ? "DFS" : "BFS",
+      function finish() {
+        m._free(inPtr);
+        m._free(ppPtr);
+
+        if (stopReason !== 0) {
+          status = "warn";
+          warnings.push(
+            "Fill stopped early (" + STOP_REASONS[stopReason] + ")."
+          );
+        }
+
+        var elapsed = performance.now() - t0;
+        self.postMessage(
+          {
+            type: "result",
+            frames: frames,
+            width: width,
+            height: height,
+            frameCount: frameCount,
+            timeMs: Math.round(elapsed),
+            status: status,
+            warning: warnings.length > 0 ? warnings.join(" ") : undefined,
+            memory: {
+              budgetBytes: budgetBytes,
+              maxFrames: msg.maxFrames,
+              estimatedBytes: estimatedBytes,
+            },
+            stats: {
+              framesCaptured: frameCount,
+              filledPixels: filledPixels,
+              stopReason: STOP_REASONS[stopReason],
+              algo: msg.algo === 1 ? "DFS" : msg.algo === 2 ? "Scanline" : "BFS",
+            },
           },
-        },
-        frames
-      );
+          frames
+        );
+      }
+
+      return Promise.resolve(pending).then(finish);
     })
     .catch(function (err) {
       self.postMessage({
@@ -260,7 +260,23 @@ function runFill() {
         pickerParams: getPickerParamsArray(),
         maxFrames: Math.max(0, parseInt(maxFramesInput.value, 10) || 0),
     };
+    let streaming = false;
     w.onmessage = (e) => {
+        if (e.data.type === "progress") {
+            // Final-only fills stream the changed rectangle after every step
+            if (!streaming && state.imageData) {
+                streaming = true;
+                outputCanvas.width = state.imageData.width;
+                outputCanvas.height = state.imageData.height;
+                outputCanvas.getContext("2d").putImageData(state.imageData, 0, 0);
+                outputPlaceholder.hidden = true;
+                outputWrap.hidden = false;
+            }
+            const { x, y, width, height, rgba } = e.data;
+            const patch = new ImageData(new Uint8ClampedArray(rgba), width, height);
+            outputCanvas.getContext("2d").putImageData(patch, x, y);
+            return;
+        }
         state.running = false;
         updateRunButton();
         if (e.data.type === "error") {